@@ -0,0 +1,109 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Host tool: drives the backup store on host directories, standing in for the save filesystem and the SD card
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include "fs.hpp"
+#include "backup.hpp"
+
+namespace {
+
+void usage(const char *name) {
+    std::printf("Usage:\n"
+        "  %s create store_dir save_dir name\n"
+        "  %s restore store_dir name save_dir\n"
+        "  %s list store_dir [max]\n", name, name, name);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto cmd = std::string_view(argv[1]);
+    fs::Filesystem store_fs;
+    if (auto rc = store_fs.open(argv[2]); R_FAILED(rc)) {
+        std::fprintf(stderr, "Failed to open %s: %#x\n", argv[2], rc);
+        return 1;
+    }
+
+    auto store = bk::BackupStore(store_fs, "/");
+    if (auto rc = store.initialize(); R_FAILED(rc)) {
+        std::fprintf(stderr, "Failed to initialize store: %#x\n", rc);
+        return 1;
+    }
+
+    if (cmd == "list") {
+        auto max = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : SIZE_MAX;
+        for (auto &name: store.list_snapshots(max)) {
+            bk::Snapshot snapshot;
+            if (auto rc = store.load_snapshot(name, snapshot); R_FAILED(rc))
+                std::printf("%s: invalid manifest (%#x)\n", name.c_str(), rc);
+            else
+                std::printf("%s: %zu files, %zu bytes\n", name.c_str(), snapshot.files.size(), snapshot.total_size());
+        }
+        return 0;
+    }
+
+    if (argc < 5) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto save_dir = (cmd == "create") ? argv[3] : argv[4];
+    auto name     = (cmd == "create") ? argv[4] : argv[3];
+    fs::Filesystem save_fs;
+    if (auto rc = save_fs.open(save_dir); R_FAILED(rc)) {
+        std::fprintf(stderr, "Failed to open %s: %#x\n", save_dir, rc);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    if (cmd == "create") {
+        bk::BackupStats stats;
+        if (auto rc = store.create_snapshot(save_fs, name, stats); R_FAILED(rc)) {
+            std::fprintf(stderr, "Backup failed: %#x\n", rc);
+            return 1;
+        }
+        std::printf("%zu files, %zu bytes in %zu chunks, %zu new chunks (%zu bytes, %zu stored) in %.1fms\n",
+            stats.num_files, stats.total_size, stats.num_chunks, stats.new_chunks, stats.new_size, stats.stored_size, elapsed());
+    } else if (cmd == "restore") {
+        if (auto rc = store.restore_snapshot(name, save_fs); R_FAILED(rc)) {
+            std::fprintf(stderr, "Restore failed: %#x\n", rc);
+            return 1;
+        }
+        std::printf("Restored %s in %.1fms\n", name, elapsed());
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    return 0;
+}
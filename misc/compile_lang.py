@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+
+# Compiles a language file to the binary string table loaded by lang.cpp
+# Nested objects are flattened to dotted keys ("days.monday")
+# With a fallback file (en.json), its keys missing from the language are filled in, so every lookup hits at runtime,
+# and the coverage of the language is reported
+#
+# Layout, little-endian:
+#   0x00  magic "TPLG"
+#   0x04  u32 version
+#   0x08  u32 number of strings
+#   0x0c  u32 size of the string blob
+#   0x10  u32 key hashes[n] (32-bit FNV-1a, see lang.hpp), sorted
+#         u32 key offsets[n]
+#         u32 value offsets[n]
+#         string blob, NUL-terminated UTF-8 keys and values
+
+import sys, json, struct
+from pathlib import Path
+
+
+MAGIC   = b"TPLG"
+VERSION = 2
+
+
+def fnv1a(data):
+    h = 0x811c9dc5
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+
+def flatten(d, prefix=""):
+    for k, v in d.items():
+        if type(v) is dict:
+            yield from flatten(v, f"{prefix}{k}.")
+        elif type(v) is str:
+            yield f"{prefix}{k}", v
+        else:
+            raise ValueError(f"{prefix}{k}: expected a string or an object, got {type(v).__name__}")
+
+
+def compile_table(strings):
+    items = sorted((fnv1a(k.encode()), k.encode(), v.encode()) for k, v in strings.items())
+    for (h, k, _), (next_h, next_k, _) in zip(items, items[1:]):
+        if h == next_h:
+            raise ValueError(f"Hash collision between {k.decode()} and {next_k.decode()}, rename one of them")
+
+    blob, offsets = bytearray(), {}
+    def intern(s):
+        if s not in offsets:
+            offsets[s] = len(blob)
+            blob.extend(s + b"\0")
+        return offsets[s]
+
+    hashes        = [h for h, _, _ in items]
+    key_offsets   = [intern(k) for _, k, _ in items]
+    value_offsets = [intern(v) for _, _, v in items]
+
+    return MAGIC + struct.pack(f"<3I{3 * len(items)}I", VERSION, len(items), len(blob),
+        *hashes, *key_offsets, *value_offsets) + blob
+
+
+def load(path):
+    with open(path, "r", encoding="utf-8") as fp:
+        return dict(flatten(json.load(fp)))
+
+
+def fill_missing(name, strings, fallback):
+    missing = [k for k in fallback if k not in strings]
+    unknown = [k for k in strings if k not in fallback]
+
+    translated = len(fallback) - len(missing)
+    print(f"{name}: {translated}/{len(fallback)} strings translated ({100 * translated / len(fallback):.0f}%)"
+        + (f", missing {', '.join(missing)}" if missing else ""))
+    if unknown:
+        print(f"{name}: unused keys {', '.join(unknown)}")
+
+    return { **{k: fallback[k] for k in missing}, **strings }
+
+
+def main(argc, argv):
+    if argc < 3:
+        print(f"Usage: {argv[0]} in.json out.bin [fallback.json]")
+        return 1
+
+    strings = load(argv[1])
+    if argc > 3:
+        strings = fill_missing(Path(argv[1]).stem, strings, load(argv[3]))
+
+    Path(argv[2]).write_bytes(compile_table(strings))
+
+
+if __name__ == "__main__":
+    sys.exit(main(len(sys.argv), sys.argv))
@@ -0,0 +1,110 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Host tool: measures the throughput of the backup chunk pipeline (hashing, compression, decompression)
+// on a file, single-threaded and spread over all cores. With a header, the file is decrypted first like
+// the backup store does
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "fs.hpp"
+#include "lz4.hpp"
+#include "save.hpp"
+#include "backup.hpp"
+#include "parallel.hpp"
+
+namespace {
+
+template <typename F>
+double measure(F f, int iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::printf("Usage: %s dir file [header] [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = (argc > 4) ? std::max(1, std::atoi(argv[4])) : 5;
+
+    fs::Filesystem fs;
+    fs::File file;
+    if (auto rc = fs.open(argv[1]) | fs.open_file(file, argv[2]); R_FAILED(rc)) {
+        std::fprintf(stderr, "Failed to open %s/%s: %#x\n", argv[1], argv[2], rc);
+        return 1;
+    }
+
+    std::vector<std::uint8_t> data;
+    if (argc > 3) {
+        fs::File header;
+        if (auto rc = fs.open_file(header, argv[3]); R_FAILED(rc)) {
+            std::fprintf(stderr, "Failed to open %s: %#x\n", argv[3], rc);
+            return 1;
+        }
+        auto [key, ctr] = sv::get_keys(header);
+        data = sv::decrypt(file, file.size(), key, ctr);
+    } else {
+        data.resize(file.size());
+        data.resize(file.read(data.data(), data.size()));
+    }
+
+    auto num_chunks = (data.size() + bk::chunk_size - 1) / bk::chunk_size;
+    auto chunk_len  = [&data](std::size_t i) { return std::min(data.size() - i * bk::chunk_size, bk::chunk_size); };
+
+    std::vector<std::vector<std::uint8_t>> packed(num_chunks);
+    std::vector<std::uint8_t> unpacked(data.size());
+
+    auto hash = [&](std::size_t i) { sv::sha256(&data[i * bk::chunk_size], chunk_len(i)); };
+    auto pack = [&](std::size_t i) { packed[i] = lz::compress(&data[i * bk::chunk_size], chunk_len(i)); };
+    auto unpack = [&](std::size_t i) {
+        if (!lz::decompress(packed[i].data(), packed[i].size(), &unpacked[i * bk::chunk_size], chunk_len(i)))
+            std::fprintf(stderr, "Chunk %zu failed to decompress\n", i);
+    };
+
+    auto packed_size = std::size_t(0);
+    for (std::size_t i = 0; i < num_chunks; ++i)
+        pack(i), packed_size += std::min(packed[i].size(), chunk_len(i));
+    for (std::size_t i = 0; i < num_chunks; ++i)
+        unpack(i);
+    if (unpacked != data) {
+        std::fprintf(stderr, "Round-trip mismatch\n");
+        return 1;
+    }
+
+    std::printf("%zu bytes in %zu chunks, %zu bytes stored (%.1f%%), %u threads\n\n", data.size(), num_chunks, packed_size,
+        100.0 * packed_size / data.size(), par::get_num_threads());
+    std::printf("%-12s %12s %12s\n", "", "1 thread", "all threads");
+
+    auto report = [&](const char *name, auto fn) {
+        auto single = measure([&] { for (std::size_t i = 0; i < num_chunks; ++i) fn(i); }, iterations);
+        auto multi  = measure([&] { par::for_each_index(num_chunks, fn); }, iterations);
+        std::printf("%-12s %8.1fMB/s %8.1fMB/s\n", name, data.size() / single / 1e6, data.size() / multi / 1e6);
+    };
+    report("sha256",     hash);
+    report("compress",   pack);
+    report("decompress", unpack);
+
+    return 0;
+}
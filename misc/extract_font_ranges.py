@@ -1,71 +1,92 @@
 #!/usr/bin/env python3
 
-import os, sys, json
+# Generates the glyph ranges of the font atlases, run by the build
+# Font atlases are built per script, from the glyphs of the languages written in it. Strings missing from a
+# language are taken from English, and printable ASCII is kept for untranslated text (numbers, dates, snapshot names,
+# the version string) and the ASCII language names. Each language name (lang/names.json) only goes in the atlas of its
+# own script, the language tab shows the ASCII name with the other atlases
+
+import sys, json
 from pathlib import Path
-from glob import glob
-
-
-# Keep that in sync with gui.cpp
-LANG_NAMES = [
-    "English",
-    "Nederlands"
-    "Français",
-    "Italiano",
-    "Deutsch",
-    "Español",
-    "Português",
-    "简体中文",
-    "繁體中文",
-    "日本語",
-    "琉球諸語",
-    "한국어",
-]
+
+
+SCRIPTS = ["Latin", "Chinese", "Korean"]
+
+
+def get_script(lang):
+    if lang.startswith("zh") or lang.startswith("ja"):
+        return "Chinese"
+    if lang == "ko":
+        return "Korean"
+    return "Latin"
 
 
 def walk_values(d):
     for v in d.values():
         if type(v) is dict:
-            for _v in walk_values(v):
-                yield _v
+            yield from walk_values(v)
         else:
             yield v
 
 
-def main(argc, argv):
-    if argc < 2:
-        print(f"Usage: {argv[0]} dir")
-        return 1
+def get_glyphs(path):
+    with open(path, "r", encoding="utf-8") as fp:
+        return set("".join(v for v in walk_values(json.load(fp)) if type(v) is str))
 
-    d = Path(argv[1])
 
-    s = set()
+def get_lang_names(path):
+    with open(path, "r", encoding="utf-8") as fp:
+        return {n["file"]: n["name"] for n in json.load(fp)}
 
-    for j in glob(str(d / "*.json")):
-        print(f"Reading {j}")
-        with open(j, "r") as fp:
-            dat = json.load(fp)
 
-        for v in walk_values(dat):
-            if type(v) is str:
-                s.update(v)
+def to_ranges(codepoints):
+    ranges = []
+    for c in sorted(codepoints):
+        if ranges and ranges[-1] == c - 1:
+            ranges[-1] = c
+        else:
+            ranges += [c, c]
+    return ranges
 
-    for l in LANG_NAMES:
-        s.update(l)
 
-    s = [ord(c) for c in sorted(s)]
+def format_table(name, ranges):
+    lines = [f"constexpr ImWchar {name}[] = {{"]
+    for i in range(0, len(ranges), 16):
+        lines.append("    " + ", ".join(f"{c:#06x}" for c in ranges[i:i+16]) + ",")
+    lines += ["    0,", "};", ""]
+    return "\n".join(lines)
 
-    ranges = []
-    for i, c in enumerate(s):
-        prevc = s[i-1] if i > 0 else c
-        nextc = s[i+1] if i < len(s)-1 else c
 
-        if c != prevc + 1:
-            ranges.append(c)
-        if c != nextc - 1:
-            ranges.append(c)
+def main(argc, argv):
+    if argc < 4:
+        print(f"Usage: {argv[0]} lang_dir names.json out.h")
+        return 1
 
-    for i in range(0, len(ranges), 16):
-        print(", ".join(f"{c:#06x}" for c in ranges[i:i+16]) + ",")
+    names  = get_lang_names(argv[2])
+    glyphs = {p.stem: get_glyphs(p) | set(names.get(p.stem, ""))
+        for p in sorted(Path(argv[1]).glob("*.json")) if p != Path(argv[2])}
+
+    common = set(map(chr, range(0x20, 0x7f))) | glyphs.get("en", set())
+
+    out = [
+        "// Autogenerated by misc/extract_font_ranges.py, do not edit",
+        "",
+        "#pragma once",
+        "",
+        "#include <imgui.h>",
+        "",
+    ]
+    for script in SCRIPTS:
+        s = set(common)
+        for lang, g in glyphs.items():
+            if get_script(lang) == script:
+                s |= g
+        s.discard("\n")
+
+        print(f"{script}: {len(s)} glyphs")
+        out.append(format_table(f"nxFontRanges{script}", to_ranges(ord(c) for c in s)))
+
+    Path(argv[3]).write_text("\n".join(out), encoding="utf-8")
 
 
 if __name__ == "__main__":
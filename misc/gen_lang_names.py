@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+
+# Generates the table of language names shown in the language tab, from lang/names.json, run by the build
+# Each language is shown under its own name, which is only in the font atlas of its script (see
+# misc/extract_font_ranges.py). The ASCII name is shown instead when another atlas is current
+
+import sys, json
+from pathlib import Path
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def main(argc, argv):
+    if argc < 3:
+        print(f"Usage: {argv[0]} names.json out.h")
+        return 1
+
+    with open(argv[1], "r", encoding="utf-8") as fp:
+        names = json.load(fp)
+
+    for n in names:
+        if not n["ascii_name"].isascii():
+            print(f"{n['language']}: ascii_name must be ASCII, got {n['ascii_name']}")
+            return 1
+
+    width = max(len(n["language"]) for n in names) + 1
+    out = [
+        f"// Autogenerated by misc/gen_lang_names.py from {Path(argv[1]).name}, do not edit",
+        "",
+        "#pragma once",
+        "",
+        '#include "lang.hpp"',
+        "",
+        "namespace lang {",
+        "",
+        "struct LanguageName {",
+        "    Language    language;",
+        "    const char *name, *ascii_name;",
+        "};",
+        "",
+        "constexpr LanguageName language_names[] = {",
+    ]
+    for n in names:
+        out.append(f"    {{ Language::{(n['language'] + ',').ljust(width)} {c_string(n['name'])}, {c_string(n['ascii_name'])} }},")
+    out += ["};", "", "} // namespace lang", ""]
+
+    Path(argv[2]).write_text("\n".join(out), encoding="utf-8")
+
+
+if __name__ == "__main__":
+    sys.exit(main(len(sys.argv), sys.argv))
@@ -0,0 +1,211 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Host tool: finds where the known structures moved between two decrypted main.dat
+// from consecutive game versions, to speed up updating the offset tables in layout.hpp
+//
+// Aligned 64-byte blocks of the old save are hashed and indexed, then a rolling hash of the
+// same width slides over the new save one word at a time. Every verified match is an anchor
+// (old offset, new offset), and each field takes the shift of the anchors surrounding it.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "layout.hpp"
+
+namespace {
+
+constexpr std::size_t block_words = 16;
+constexpr std::size_t block_size  = block_words * sizeof(std::uint32_t);
+constexpr std::uint32_t hash_mult = 0x01000193;
+
+// Only look this far around a field for anchors
+constexpr std::size_t anchor_window = 0x10000;
+
+using u32x4 = std::uint32_t __attribute__((vector_size(16)));
+
+struct Anchor {
+    std::uint32_t old_offset, new_offset;
+
+    constexpr inline std::int64_t delta() const {
+        return static_cast<std::int64_t>(this->new_offset) - this->old_offset;
+    }
+};
+
+// Powers of the multiplier so that hash(w) = sum(w[i] * mult^(15 - i)), which the rolling hash can update
+constexpr auto hash_powers = [] {
+    std::array<std::uint32_t, block_words> pow = {};
+    std::uint32_t p = 1;
+    for (std::size_t i = 0; i < block_words; ++i)
+        pow[block_words - 1 - i] = p, p *= hash_mult;
+    return pow;
+}();
+
+inline std::uint32_t hash_block(const std::uint32_t *words) {
+    u32x4 acc = {};
+    for (std::size_t i = 0; i < block_words; i += 4) {
+        u32x4 w, p;
+        std::memcpy(&w, &words[i],       sizeof(w));
+        std::memcpy(&p, &hash_powers[i], sizeof(p));
+        acc += w * p;
+    }
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+// Blocks of a single repeated word (padding, empty slots) would match anywhere
+inline bool is_uniform(const std::uint32_t *words) {
+    return std::all_of(words + 1, words + block_words, [words](std::uint32_t w) { return w == words[0]; });
+}
+
+bool read_file(const char *path, std::vector<std::uint32_t> &words) {
+    auto *fp = std::fopen(path, "rb");
+    if (!fp) {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    std::fseek(fp, 0, SEEK_END);
+    std::size_t size = std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+
+    words.resize(size / sizeof(std::uint32_t));
+    auto read = std::fread(words.data(), sizeof(std::uint32_t), words.size(), fp);
+    std::fclose(fp);
+
+    if (read != words.size()) {
+        std::fprintf(stderr, "Failed to read %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+std::vector<Anchor> find_anchors(const std::vector<std::uint32_t> &old_words, const std::vector<std::uint32_t> &new_words) {
+    constexpr auto ambiguous = UINT32_MAX;
+
+    std::unordered_map<std::uint32_t, std::uint32_t> index;
+    index.reserve(old_words.size() / block_words);
+    for (std::size_t i = 0; i + block_words <= old_words.size(); i += block_words) {
+        if (is_uniform(&old_words[i]))
+            continue;
+        auto [it, inserted] = index.try_emplace(hash_block(&old_words[i]), i);
+        if (!inserted)
+            it->second = ambiguous;
+    }
+
+    std::vector<Anchor> anchors;
+    if (new_words.size() < block_words)
+        return anchors;
+
+    auto top_power = hash_powers[0];
+    auto hash      = hash_block(new_words.data());
+    for (std::size_t i = 0;; ++i) {
+        if (auto it = index.find(hash); (it != index.end()) && (it->second != ambiguous)) {
+            if (!std::memcmp(&old_words[it->second], &new_words[i], block_size))
+                anchors.push_back({static_cast<std::uint32_t>(it->second * sizeof(std::uint32_t)),
+                    static_cast<std::uint32_t>(i * sizeof(std::uint32_t))});
+        }
+
+        if (i + block_words >= new_words.size())
+            break;
+        hash = (hash - new_words[i] * top_power) * hash_mult + new_words[i + block_words];
+    }
+
+    std::sort(anchors.begin(), anchors.end(), [](const Anchor &lhs, const Anchor &rhs) {
+        return lhs.old_offset < rhs.old_offset;
+    });
+    return anchors;
+}
+
+struct Shift {
+    std::int64_t delta;
+    std::size_t  votes, total;
+    bool         exact;
+};
+
+// Anchors closest to the field win, so that a shift introduced just after it doesn't leak in
+Shift find_shift(const std::vector<Anchor> &anchors, std::size_t offset) {
+    auto lo = std::lower_bound(anchors.begin(), anchors.end(), offset - std::min(offset, anchor_window),
+        [](const Anchor &a, std::size_t off) { return a.old_offset < off; });
+    auto hi = std::lower_bound(lo, anchors.end(), offset + anchor_window,
+        [](const Anchor &a, std::size_t off) { return a.old_offset < off; });
+    if (lo == hi)
+        return {0, 0, 0, false};
+
+    auto closest = std::min_element(lo, hi, [offset](const Anchor &lhs, const Anchor &rhs) {
+        auto dist = [offset](const Anchor &a) {
+            return (a.old_offset > offset) ? a.old_offset - offset : offset - a.old_offset;
+        };
+        return dist(lhs) < dist(rhs);
+    });
+
+    auto delta = closest->delta();
+    auto votes = std::count_if(lo, hi, [delta](const Anchor &a) { return a.delta() == delta; });
+    bool exact = (closest->old_offset <= offset) && (offset < closest->old_offset + block_size);
+    return {delta, static_cast<std::size_t>(votes), static_cast<std::size_t>(hi - lo), exact};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        std::printf("Usage: %s old_version old_main.dat new_main.dat\n", argv[0]);
+        return 1;
+    }
+
+    auto name = std::string_view(argv[1]);
+    auto it   = std::find(tp::layout::version_names.begin(), tp::layout::version_names.end(), name);
+    if (it == tp::layout::version_names.end()) {
+        std::fprintf(stderr, "Unknown version %s\n", argv[1]);
+        return 1;
+    }
+    auto version = static_cast<std::size_t>(it - tp::layout::version_names.begin());
+
+    std::vector<std::uint32_t> old_words, new_words;
+    if (!read_file(argv[2], old_words) || !read_file(argv[3], new_words))
+        return 1;
+
+    auto start   = std::chrono::steady_clock::now();
+    auto anchors = find_anchors(old_words, new_words);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu anchors in %.1fms\n\n", anchors.size(), elapsed);
+    std::printf("%-14s %-6s %-10s %-10s %-10s %s\n", "field", "size", "old", "new", "delta", "confidence");
+
+    for (auto &field: tp::layout::fields) {
+        auto offset = field.offsets[version];
+        auto shift  = find_shift(anchors, offset);
+        if (!shift.total) {
+            std::printf("%-14s %#-6zx %#-10lx %-10s %-10s no anchors nearby\n", field.name, field.size, offset, "?", "?");
+            continue;
+        }
+
+        auto new_offset = static_cast<std::int64_t>(offset) + shift.delta;
+        std::printf("%-14s %#-6zx %#-10lx %#-10lx %c%#-9lx %zu/%zu anchors%s\n", field.name, field.size, offset, new_offset,
+            (shift.delta < 0) ? '-' : '+', static_cast<unsigned long>(std::abs(shift.delta)), shift.votes, shift.total,
+            shift.exact ? ", inside a matched block" : "");
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Host tool: runs the same load pipeline as the application (keys, decryption, version, sections)
+// on a save directory through the POSIX fs:: backend, and reports the time spent in each step
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "fs.hpp"
+#include "lang.hpp"
+#include "save.hpp"
+#include "parser.hpp"
+#include "island.hpp"
+
+namespace {
+
+constexpr auto save_hdr_path  = "/mainHeader.dat";
+constexpr auto save_main_path = "/main.dat";
+
+class StepTimer {
+    private:
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double total = 0;
+
+    public:
+        inline void step(const char *name) {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration<double, std::milli>(now - this->start).count();
+            std::printf("  %-12s %8.3fms\n", name, elapsed);
+            this->total += elapsed, this->start = now;
+        }
+
+        inline double get_total() const {
+            return this->total;
+        }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::printf("Usage: %s save_dir [iterations]\n", argv[0]);
+        return 1;
+    }
+    int iterations = (argc > 2) ? std::max(1, std::atoi(argv[2])) : 1;
+
+    for (int i = 0; i < iterations; ++i) {
+        std::printf("Run %d:\n", i);
+        StepTimer timer;
+
+        lang::prefetch();
+
+        fs::Filesystem fs;
+        fs::File header, main;
+        if (auto rc = fs.open(argv[1]); R_FAILED(rc)) {
+            std::fprintf(stderr, "Failed to open %s: %#x\n", argv[1], rc);
+            return 1;
+        }
+        if (auto rc = fs.open_file(header, save_hdr_path) | fs.open_file(main, save_main_path); R_FAILED(rc)) {
+            std::fprintf(stderr, "Failed to open save files: %#x\n", rc);
+            return 1;
+        }
+        timer.step("open");
+
+        // The version info and the encryption data are read separately, fetch both at once
+        header.enable_cache();
+        header.read_ranges({{ 0, sizeof(tp::VersionInfo) }, { sv::crypt_data_offset, sv::crypt_data_size }});
+
+        auto [key, ctr] = sv::get_keys(header);
+        timer.step("keys");
+
+        auto decrypted = sv::decrypt(main, main.size(), key, ctr);
+        timer.step("decrypt");
+
+        auto version = static_cast<tp::Version>(tp::VersionParser(header));
+        timer.step("version");
+
+        auto island = tp::IslandSnapshot(version, sv::SaveView(decrypted));
+        auto &turnips = island.turnips();
+        auto &date    = island.date();
+        timer.step("sections");
+
+        if (auto rc = lang::set_language(lang::Language::Default); R_FAILED(rc))
+            std::fprintf(stderr, "Failed to load language file (%#x), run from the repository root\n", rc);
+        lang::update(true);
+        timer.step("language");
+
+        std::printf("  %-12s %8.3fms\n", "total", timer.get_total());
+        if (i == iterations - 1)
+            std::printf("Version %s, buy price %u, date %04u-%02u-%02u\n",
+                (version != tp::Version::Unknown) ? tp::layout::version_names[static_cast<std::size_t>(version)] : "unknown",
+                turnips.prices.buy_price, date.date.year, date.date.month, date.date.day);
+    }
+
+    auto lang_mem = lang::get_memory_report();
+    std::printf("Language tables: %zu languages in %zu bytes, largest %zu bytes\n",
+        lang_mem.num_tables, lang_mem.arena_size, lang_mem.largest_table);
+
+    if constexpr (fs::stats::is_enabled) {
+        std::printf("\n");
+        fs::stats::dump(stdout);
+    }
+
+    return 0;
+}
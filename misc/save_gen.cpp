@@ -0,0 +1,233 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+// Host tool: writes a synthetic encrypted save (mainHeader.dat + main.dat) for any known version,
+// with chosen values at that version's offsets, so the decrypt/parse pipeline can run without a console
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <getopt.h>
+
+#include "crypto.hpp"
+#include "layout.hpp"
+
+namespace {
+
+constexpr std::size_t header_size       = sv::crypt_data_offset + sv::crypt_data_size;
+constexpr std::size_t default_save_size = 0xc00000;
+constexpr std::int64_t max_save_size     = 0x10000000;
+
+// Not in the version table, so the header is reported as unknown
+constexpr tp::VersionInfo unknown_version_info = { 0xffffffff, 0xffffffff, 2, 0, 2, 0xffff };
+
+struct Options {
+    std::size_t        version    = static_cast<std::size_t>(tp::Version::Total) - 1;
+    std::size_t        save_size  = default_save_size;
+    std::int64_t       shift      = 0;
+    std::uint32_t      rng_seed   = 0;
+    bool               zero_fill  = false;
+    tp::TurnipPrices   prices     = { 100, {{ 0, 0, 90, 85, 80, 140, 200, 550, 180, 120, 70, 65, 60, 55 }}, 1, 0 };
+    tp::VisitorSchedule schedule  = {};
+    tp::Date           date       = { 2021, 11, 5, 12, 0, 0 };
+    tp::WeatherInfo    weather    = { 0, 0x12345678 };
+};
+
+void usage(const char *name) {
+    std::printf("Usage: %s [options] out_dir\n"
+        "  -v version   game version (eg. 3.0.3) or \"unknown\", defaults to the latest\n"
+        "  -S shift     with -v unknown, offset added to the latest version's offsets\n"
+        "  -z size      size of main.dat, defaults to %#zx\n"
+        "  -r seed      rng seed for the filler and encryption data\n"
+        "  -0           fill main.dat with zeroes instead of random data\n"
+        "  -b price     turnip buy price\n"
+        "  -p prices    14 comma-separated turnip prices, sunday am to saturday pm\n"
+        "  -t pattern   turnip pattern (0-3)\n"
+        "  -n npcs      7 comma-separated visitor ids, sunday to saturday\n"
+        "  -d date      save date, as YYYY-MM-DD-hh-mm-ss\n"
+        "  -H hemi      hemisphere (0: northern, 1: southern)\n"
+        "  -s seed      raw weather seed\n", name, default_save_size);
+}
+
+// Parses a number at the start of `str` into `out`, failing if it isn't within [min, max]
+template <typename T>
+bool parse_number(const char *str, char **end, T &out,
+        std::int64_t min = std::numeric_limits<T>::min(), std::int64_t max = std::numeric_limits<T>::max()) {
+    errno = 0;
+    auto val = std::strtoll(str, end, 0);
+    if ((*end == str) || (errno == ERANGE) || (val < min) || (val > max))
+        return false;
+    out = static_cast<T>(val);
+    return true;
+}
+
+// The whole argument must be a number
+template <typename T>
+bool parse_number(const char *str, T &out,
+        std::int64_t min = std::numeric_limits<T>::min(), std::int64_t max = std::numeric_limits<T>::max()) {
+    char *end;
+    return parse_number(str, &end, out, min, max) && (*end == '\0');
+}
+
+template <typename T>
+bool parse_list(const char *str, T *out, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        char *end;
+        if (!parse_number(str, &end, out[i]) || (*end != ((i != count - 1) ? ',' : '\0')))
+            return false;
+        str = end + 1;
+    }
+    return true;
+}
+
+bool write_file(const std::string &path, const void *data, std::size_t size) {
+    auto *fp = std::fopen(path.c_str(), "wb");
+    if (!fp) {
+        std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return false;
+    }
+    auto written = std::fwrite(data, 1, size, fp);
+    std::fclose(fp);
+    return written == size;
+}
+
+template <typename T>
+void put(std::vector<std::uint8_t> &save, std::size_t offset, const T &val) {
+    if (offset + sizeof(T) > save.size()) {
+        std::fprintf(stderr, "Offset %#zx out of bounds, skipping\n", offset);
+        return;
+    }
+    std::memcpy(&save[offset], &val, sizeof(T));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options opts;
+    bool is_unknown = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "v:S:z:r:0b:p:t:n:d:H:s:h")) != -1) {
+        bool ok = true;
+        switch (opt) {
+            case 'v': {
+                if (auto name = std::string_view(optarg); name == "unknown") {
+                    is_unknown = true;
+                } else {
+                    auto it = std::find(tp::layout::version_names.begin(), tp::layout::version_names.end(), name);
+                    ok = it != tp::layout::version_names.end();
+                    opts.version = it - tp::layout::version_names.begin();
+                }
+                break;
+            }
+            case 'S': ok = parse_number(optarg, opts.shift, -max_save_size, max_save_size); break;
+            case 'z': ok = parse_number(optarg, opts.save_size, 1, max_save_size);          break;
+            case 'r': ok = parse_number(optarg, opts.rng_seed);                             break;
+            case '0': opts.zero_fill = true;                                                break;
+            case 'b': ok = parse_number(optarg, opts.prices.buy_price);                     break;
+            case 't': ok = parse_number(optarg, opts.prices.pattern_type, 0, 3);            break;
+            case 'p': ok = parse_list(optarg, opts.prices.week_prices.data(), opts.prices.week_prices.size()); break;
+            case 'n': ok = parse_list(optarg, opts.schedule.npcs.data(),      opts.schedule.npcs.size());      break;
+            case 'd': {
+                unsigned y, mo, d, h, mi, s;
+                ok = std::sscanf(optarg, "%u-%u-%u-%u-%u-%u", &y, &mo, &d, &h, &mi, &s) == 6;
+                opts.date = { static_cast<std::uint16_t>(y), static_cast<std::uint8_t>(mo), static_cast<std::uint8_t>(d),
+                    static_cast<std::uint8_t>(h), static_cast<std::uint8_t>(mi), static_cast<std::uint8_t>(s) };
+                break;
+            }
+            case 'H': ok = parse_number(optarg, opts.weather.hemisphere, 0, 1); break;
+            case 's': ok = parse_number(optarg, opts.weather.raw_seed);         break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "Invalid argument for -%c: %s\n", opt, optarg);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    auto out_dir = std::string(argv[optind]);
+
+    // Shifted structures must still start inside main.dat
+    if (is_unknown) {
+        for (auto &field: tp::layout::fields) {
+            auto offset = static_cast<std::int64_t>(field.offsets.back()) + opts.shift;
+            if ((offset < 0) || (offset + field.size > opts.save_size)) {
+                std::fprintf(stderr, "Shift %+ld moves %s out of main.dat\n", static_cast<long>(opts.shift), field.name);
+                return 1;
+            }
+        }
+    }
+
+    if (std::error_code ec; !std::filesystem::create_directories(out_dir, ec) && ec) {
+        std::fprintf(stderr, "Failed to create %s: %s\n", out_dir.c_str(), ec.message().c_str());
+        return 1;
+    }
+
+    std::mt19937 rng(opts.rng_seed);
+
+    // Header: version info, then the data the keys are derived from
+    std::vector<std::uint8_t> header(header_size, 0);
+    auto info = is_unknown ? unknown_version_info : tp::layout::version_infos[opts.version];
+    std::memcpy(header.data(), &info, sizeof(info));
+
+    std::vector<std::uint32_t> crypt_data(sv::crypt_data_size / sizeof(std::uint32_t));
+    std::generate(crypt_data.begin(), crypt_data.end(), rng);
+    std::memcpy(&header[sv::crypt_data_offset], crypt_data.data(), sv::crypt_data_size);
+
+    auto key = sv::get_param(crypt_data, 0);
+    auto ctr = sv::get_param(crypt_data, 2);
+
+    // Plaintext, with the structures at the version's offsets
+    std::vector<std::uint8_t> save(opts.save_size, 0);
+    if (!opts.zero_fill)
+        std::generate(save.begin(), save.end(), [&rng] { return static_cast<std::uint8_t>(rng()); });
+
+    auto offset = [&](const auto &offsets) -> std::size_t {
+        return is_unknown ? offsets.back() + opts.shift : offsets[opts.version];
+    };
+    put(save, offset(tp::layout::turnip_offsets),       opts.prices);
+    put(save, offset(tp::layout::visitor_offsets),      opts.schedule);
+    put(save, offset(tp::layout::date_offsets),         opts.date);
+    put(save, offset(tp::layout::weather_info_offsets), opts.weather);
+
+    auto aes = sv::Aes128Ctr(key, ctr);
+    aes.crypt(save.data(), save.data(), save.size());
+
+    if (!write_file(out_dir + "/mainHeader.dat", header.data(), header.size()) ||
+            !write_file(out_dir + "/main.dat", save.data(), save.size()))
+        return 1;
+
+    std::printf("Wrote %s save (%#zx bytes) to %s\n",
+        is_unknown ? "unknown version" : tp::layout::version_names[opts.version], save.size(), out_dir.c_str());
+    return 0;
+}
@@ -0,0 +1,485 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "backup.hpp"
+#include "lz4.hpp"
+#include "save.hpp"
+#include "parallel.hpp"
+
+namespace bk {
+
+namespace {
+
+constexpr std::string_view manifest_magic = "turnips-backup 2";
+
+// Custom module so these can't be mistaken for libnx results or errno values
+constexpr inline Result make_result(std::uint32_t desc) {
+    return 0x1ff | (desc << 9);
+}
+
+constexpr Result ResultShortRead   = make_result(1);
+constexpr Result ResultBadManifest = make_result(2);
+constexpr Result ResultBadChunk    = make_result(3);
+
+std::string to_hex(const sv::Hash &hash) {
+    constexpr auto digits = "0123456789abcdef";
+    std::string str(2 * hash.size(), 0);
+    for (std::size_t i = 0; i < hash.size(); ++i)
+        str[2 * i] = digits[hash[i] >> 4], str[2 * i + 1] = digits[hash[i] & 0xf];
+    return str;
+}
+
+bool from_hex(std::string_view str, sv::Hash &hash) {
+    if (str.size() != 2 * hash.size())
+        return false;
+
+    auto nibble = [](char c) -> int {
+        if ((c >= '0') && (c <= '9')) return c - '0';
+        if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+        return -1;
+    };
+
+    for (std::size_t i = 0; i < hash.size(); ++i) {
+        auto hi = nibble(str[2 * i]), lo = nibble(str[2 * i + 1]);
+        if ((hi < 0) || (lo < 0))
+            return false;
+        hash[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+std::string join_path(const std::string &dir, const char *name) {
+    return (dir.back() == '/') ? dir + name : dir + '/' + name;
+}
+
+// XHeader.dat for X.dat
+std::string get_header_path(const std::string &path) {
+    constexpr std::string_view ext = ".dat", suffix = "Header.dat";
+    if (!path.ends_with(ext) || path.ends_with(suffix))
+        return {};
+    return path.substr(0, path.size() - ext.size()) + std::string(suffix);
+}
+
+void collect_files(fs::Filesystem &fs, const std::string &dir, std::vector<std::pair<std::string, std::size_t>> &files) {
+    fs::Directory d;
+    if (auto rc = fs.open_directory(d, dir); R_FAILED(rc)) {
+        printf("Failed to open directory %s: %#x\n", dir.c_str(), rc);
+        return;
+    }
+
+    auto entries = d.entries();
+    for (auto &entry: entries) {
+        auto path = join_path(dir, entry.name);
+        if (entry.type == fs::EntryType_Dir)
+            collect_files(fs, path, files);
+        else
+            files.emplace_back(std::move(path), entry.file_size);
+    }
+    if (auto rc = entries.error(); R_FAILED(rc))
+        printf("Failed to read directory %s: %#x\n", dir.c_str(), rc);
+}
+
+Result read_whole(fs::Filesystem &fs, const std::string &path, std::vector<std::uint8_t> &contents) {
+    fs::File f;
+    if (auto rc = fs.open_file(f, path); R_FAILED(rc))
+        return rc;
+
+    contents.resize(f.size());
+    if (f.read(contents.data(), contents.size()) != contents.size())
+        return ResultShortRead;
+    return 0;
+}
+
+Result write_whole(fs::Filesystem &fs, const std::string &path, const void *data, std::size_t size) {
+    if (fs.is_file(path))
+        fs.delete_file(path);
+    if (auto rc = fs.create_file(path, size); R_FAILED(rc))
+        return rc;
+
+    fs::File f;
+    if (auto rc = fs.open_file(f, path, fs::OpenMode_Write); R_FAILED(rc))
+        return rc;
+    return f.write(data, size);
+}
+
+} // namespace
+
+Result BackupStore::initialize() {
+    if (auto rc = this->fs.create_directories(this->root + "/snapshots"); R_FAILED(rc))
+        return rc;
+
+    // Every chunk directory is created up front, so storing a chunk doesn't have to check for its directory
+    // They are created in order, so the last one existing means they all do
+    auto chunks_dir = this->root + "/chunks/";
+    if (this->fs.is_directory(chunks_dir + "ff"))
+        return 0;
+    if (auto rc = this->fs.create_directories(chunks_dir + "00"); R_FAILED(rc))
+        return rc;
+    for (unsigned i = 1; i < 0x100; ++i) {
+        char name[3];
+        std::snprintf(name, sizeof(name), "%02x", i);
+        if (auto rc = this->fs.create_directory(chunks_dir + name); R_FAILED(rc) && !this->fs.is_directory(chunks_dir + name))
+            return rc;
+    }
+    return 0;
+}
+
+std::string BackupStore::chunk_path(const sv::Hash &hash) const {
+    auto hex = to_hex(hash);
+    return this->root + "/chunks/" + hex.substr(0, 2) + "/" + hex;
+}
+
+std::string BackupStore::snapshot_path(const std::string &name) const {
+    return this->root + "/snapshots/" + name;
+}
+
+bool BackupStore::has_chunk(const sv::Hash &hash) {
+    return this->fs.is_file(this->chunk_path(hash));
+}
+
+Result BackupStore::load_chunk(const sv::Hash &hash, std::size_t size, std::vector<std::uint8_t> &data) {
+    std::vector<std::uint8_t> stored;
+    if (auto rc = read_whole(this->fs, this->chunk_path(hash), stored); R_FAILED(rc))
+        return rc;
+
+    // Chunks are only stored compressed when that makes them smaller
+    if (stored.size() == size) {
+        data = std::move(stored);
+        return 0;
+    }
+
+    data.resize(size);
+    return lz::decompress(stored.data(), stored.size(), data.data(), size) ? 0 : ResultBadChunk;
+}
+
+Result BackupStore::store_chunk(const sv::Hash &hash, const std::uint8_t *data, std::size_t size) {
+    auto path = this->chunk_path(hash);
+
+    // Written under a temporary name, so a failed or interrupted write never leaves a bad chunk behind its hash,
+    // which later backups would take as already stored
+    auto tmp_path = path + ".tmp";
+    if (auto rc = write_whole(this->fs, tmp_path, data, size); R_FAILED(rc)) {
+        this->fs.delete_file(tmp_path);
+        return rc;
+    }
+    return this->fs.move_file(tmp_path, path);
+}
+
+Result BackupStore::backup_file(fs::Filesystem &save, FileEntry &entry, sv::Aes128Ctr *aes, BackupStats &stats) {
+    fs::File f;
+    if (auto rc = save.open_file(f, entry.path); R_FAILED(rc))
+        return rc;
+
+    auto size = entry.size;
+    entry.chunks.reserve((size + chunk_size - 1) / chunk_size);
+
+    // Batches go through read (I/O worker), decryption, hashing and compression (all cores), then writing
+    // The next batch is read in the background while the current one is processed
+    constexpr std::size_t batch_size = batch_chunks * chunk_size;
+    std::array<std::vector<std::uint8_t>, 2> bufs = { std::vector<std::uint8_t>(batch_size), std::vector<std::uint8_t>(batch_size) };
+    std::array<sv::Hash, batch_chunks> hashes;
+    std::array<std::vector<std::uint8_t>, batch_chunks> packed;
+
+    f.prefetch(0, size);
+    auto pending = f.read_async(bufs[0].data(), std::min(size, batch_size), 0);
+    for (std::size_t i = 0, offset = 0; offset < size; i ^= 1) {
+        auto read = pending.wait();
+        if (read != std::min(size - offset, batch_size)) {
+            printf("Short read on %s at %#lx\n", entry.path.c_str(), offset);
+            return ResultShortRead;
+        }
+        if (offset + read < size)
+            pending = f.read_async(bufs[i ^ 1].data(), std::min(size - offset - read, batch_size), offset + read);
+
+        auto *buf = bufs[i].data();
+        if (aes)
+            aes->crypt(buf, buf, read);
+
+        auto num_chunks = (read + chunk_size - 1) / chunk_size;
+        auto chunk_len  = [read](std::size_t j) { return std::min(read - j * chunk_size, chunk_size); };
+
+        par::for_each_index(num_chunks, [&](std::size_t j) {
+            hashes[j] = sv::sha256(buf + j * chunk_size, chunk_len(j));
+        });
+
+        // Identical chunks within the batch (eg. zeroed areas) are only stored once
+        std::vector<std::size_t> missing;
+        for (std::size_t j = 0; j < num_chunks; ++j) {
+            auto is_dup = std::any_of(missing.begin(), missing.end(), [&](std::size_t k) { return hashes[k] == hashes[j]; });
+            if (!is_dup && !this->has_chunk(hashes[j]))
+                missing.push_back(j);
+        }
+
+        par::for_each_index(missing.size(), [&](std::size_t k) {
+            auto j = missing[k];
+            packed[j] = lz::compress(buf + j * chunk_size, chunk_len(j));
+        });
+
+        for (auto j: missing) {
+            bool is_compressed = packed[j].size() < chunk_len(j);
+            auto *data  = is_compressed ? packed[j].data() : buf + j * chunk_size;
+            auto stored = is_compressed ? packed[j].size() : chunk_len(j);
+            if (auto rc = this->store_chunk(hashes[j], data, stored); R_FAILED(rc))
+                return rc;
+            ++stats.new_chunks, stats.new_size += chunk_len(j), stats.stored_size += stored;
+        }
+
+        entry.chunks.insert(entry.chunks.end(), hashes.begin(), hashes.begin() + num_chunks);
+        stats.num_chunks += num_chunks;
+        offset += read;
+    }
+
+    ++stats.num_files, stats.total_size += size;
+    return 0;
+}
+
+Result BackupStore::write_manifest(const Snapshot &snapshot) {
+    std::string manifest(manifest_magic);
+    manifest += '\n';
+    for (auto &file: snapshot.files) {
+        manifest += "file " + std::to_string(file.size) + " " + file.path + "\n";
+        if (!file.header.empty())
+            manifest += "crypt " + file.header + "\n";
+        for (auto &hash: file.chunks)
+            manifest += to_hex(hash) + "\n";
+    }
+
+    // Same as chunks, the snapshot only appears once complete
+    auto path = this->snapshot_path(snapshot.name), tmp_path = path + ".tmp";
+    if (auto rc = write_whole(this->fs, tmp_path, manifest.data(), manifest.size()); R_FAILED(rc))
+        return rc;
+    if (auto rc = this->fs.move_file(tmp_path, path); R_FAILED(rc))
+        return rc;
+    return this->fs.flush();
+}
+
+Result BackupStore::create_snapshot(fs::Filesystem &save, const std::string &name, BackupStats &stats) {
+    stats = {};
+
+    std::vector<std::pair<std::string, std::size_t>> files;
+    collect_files(save, "/", files);
+    std::sort(files.begin(), files.end());
+
+    Snapshot snapshot = { name, {} };
+    snapshot.files.reserve(files.size());
+    for (auto &[path, size]: files) {
+        auto &entry = snapshot.files.emplace_back();
+        entry.path = path, entry.size = size;
+
+        // Files with a header next to them are encrypted with the keys it holds
+        std::optional<sv::Aes128Ctr> aes;
+        auto header = get_header_path(path);
+        if (!header.empty() && std::any_of(files.begin(), files.end(), [&header](const auto &f) { return f.first == header; })) {
+            fs::File f;
+            if (auto rc = save.open_file(f, header); R_FAILED(rc))
+                return rc;
+            auto [key, ctr] = sv::get_keys(f);
+            aes.emplace(key, ctr);
+            entry.header = std::move(header);
+        }
+
+        if (auto rc = this->backup_file(save, entry, aes ? &*aes : nullptr, stats); R_FAILED(rc)) {
+            printf("Failed to back up %s: %#x\n", path.c_str(), rc);
+            return rc;
+        }
+    }
+
+    return this->write_manifest(snapshot);
+}
+
+Result BackupStore::load_snapshot(const std::string &name, Snapshot &snapshot) {
+    std::vector<std::uint8_t> contents;
+    if (auto rc = read_whole(this->fs, this->snapshot_path(name), contents); R_FAILED(rc))
+        return rc;
+
+    auto str = std::string_view(reinterpret_cast<const char *>(contents.data()), contents.size());
+    auto next_line = [&str]() {
+        auto pos  = str.find('\n');
+        auto line = str.substr(0, pos);
+        str = (pos == std::string_view::npos) ? std::string_view() : str.substr(pos + 1);
+        return line;
+    };
+
+    if (next_line() != manifest_magic)
+        return ResultBadManifest;
+
+    snapshot = { name, {} };
+    while (!str.empty()) {
+        auto line = next_line();
+        if (line.empty())
+            continue;
+
+        if (line.starts_with("file ")) {
+            auto &file = snapshot.files.emplace_back();
+            auto sep = line.find(' ', 5);
+            if (sep == std::string_view::npos)
+                return ResultBadManifest;
+            file.size = std::strtoull(std::string(line.substr(5, sep - 5)).c_str(), nullptr, 10);
+            file.path = line.substr(sep + 1);
+            continue;
+        }
+
+        if (line.starts_with("crypt ")) {
+            if (snapshot.files.empty())
+                return ResultBadManifest;
+            snapshot.files.back().header = line.substr(6);
+            continue;
+        }
+
+        if (snapshot.files.empty() || !from_hex(line, snapshot.files.back().chunks.emplace_back()))
+            return ResultBadManifest;
+    }
+
+    for (auto &file: snapshot.files)
+        if (file.chunks.size() != (file.size + chunk_size - 1) / chunk_size)
+            return ResultBadManifest;
+    return 0;
+}
+
+Result BackupStore::get_file_keys(const Snapshot &snapshot, const FileEntry &entry, std::pair<sv::Key, sv::Key> &keys) {
+    auto it = std::find_if(snapshot.files.begin(), snapshot.files.end(), [&entry](const FileEntry &f) { return f.path == entry.header; });
+    if ((it == snapshot.files.end()) || !it->header.empty())
+        return ResultBadManifest;
+
+    std::vector<std::uint8_t> header, chunk;
+    for (std::size_t i = 0; i < it->chunks.size(); ++i) {
+        if (auto rc = this->load_chunk(it->chunks[i], std::min(it->size - i * chunk_size, chunk_size), chunk); R_FAILED(rc))
+            return rc;
+        header.insert(header.end(), chunk.begin(), chunk.end());
+    }
+
+    keys = sv::get_keys(header.data(), header.size());
+    return 0;
+}
+
+Result BackupStore::restore_file(fs::Filesystem &save, const FileEntry &entry, sv::Aes128Ctr *aes) {
+    fs::File f;
+    if (!save.is_file(entry.path)) {
+        if (auto pos = entry.path.rfind('/'); pos && (pos != std::string::npos))
+            save.create_directories(entry.path.substr(0, pos));
+        if (auto rc = save.create_file(entry.path, entry.size); R_FAILED(rc))
+            return rc;
+    }
+    if (auto rc = save.open_file(f, entry.path, fs::OpenMode_Write); R_FAILED(rc))
+        return rc;
+    if (auto rc = f.size(entry.size); R_FAILED(rc))
+        return rc;
+
+    // Chunks are decompressed and written one at a time
+    std::vector<std::uint8_t> buf;
+    for (std::size_t i = 0; i < entry.chunks.size(); ++i) {
+        if (auto rc = this->load_chunk(entry.chunks[i], std::min(entry.size - i * chunk_size, chunk_size), buf); R_FAILED(rc))
+            return rc;
+        if (aes)
+            aes->crypt(buf.data(), buf.data(), buf.size());
+        if (auto rc = f.write(buf.data(), buf.size(), i * chunk_size); R_FAILED(rc))
+            return rc;
+    }
+    return 0;
+}
+
+Result BackupStore::restore_snapshot(const std::string &name, fs::Filesystem &save) {
+    Snapshot snapshot;
+    if (auto rc = this->load_snapshot(name, snapshot); R_FAILED(rc))
+        return rc;
+
+    // Nothing is written unless every chunk is present and intact
+    std::vector<std::pair<sv::Hash, std::size_t>> chunks;
+    for (auto &file: snapshot.files)
+        for (std::size_t i = 0; i < file.chunks.size(); ++i)
+            chunks.emplace_back(file.chunks[i], std::min(file.size - i * chunk_size, chunk_size));
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+
+    std::atomic<Result> check_rc = 0;
+    par::for_each_index(chunks.size(), [&](std::size_t i) {
+        std::vector<std::uint8_t> buf;
+        auto &[hash, size] = chunks[i];
+        auto rc = this->load_chunk(hash, size, buf);
+        if (R_SUCCEEDED(rc) && (sv::sha256(buf.data(), buf.size()) != hash))
+            rc = ResultBadChunk;
+        if (R_FAILED(rc)) {
+            printf("Chunk %s is missing or corrupted: %#x\n", to_hex(hash).c_str(), rc);
+            check_rc = rc;
+        }
+    });
+    if (R_FAILED(check_rc.load()))
+        return check_rc;
+
+    // The save is put back in the state of the snapshot, so files created since are removed (empty directories stay)
+    std::vector<std::pair<std::string, std::size_t>> existing;
+    collect_files(save, "/", existing);
+    for (auto &[path, size]: existing) {
+        auto in_snapshot = std::any_of(snapshot.files.begin(), snapshot.files.end(), [&path](const FileEntry &f) { return f.path == path; });
+        if (in_snapshot)
+            continue;
+        if (auto rc = save.delete_file(path); R_FAILED(rc)) {
+            printf("Failed to delete %s: %#x\n", path.c_str(), rc);
+            return rc;
+        }
+    }
+
+    for (auto &file: snapshot.files) {
+        std::optional<sv::Aes128Ctr> aes;
+        if (!file.header.empty()) {
+            std::pair<sv::Key, sv::Key> keys;
+            if (auto rc = this->get_file_keys(snapshot, file, keys); R_FAILED(rc))
+                return rc;
+            aes.emplace(keys.first, keys.second);
+        }
+
+        if (auto rc = this->restore_file(save, file, aes ? &*aes : nullptr); R_FAILED(rc)) {
+            printf("Failed to restore %s: %#x\n", file.path.c_str(), rc);
+            return rc;
+        }
+    }
+
+    // Only committed once every file was written back, on failure the save keeps its previous contents
+    return save.flush();
+}
+
+std::vector<std::string> BackupStore::list_snapshots(std::size_t max) {
+    std::vector<std::string> names;
+
+    fs::Directory d;
+    if (auto rc = this->fs.open_directory(d, this->root + "/snapshots"); R_FAILED(rc))
+        return names;
+
+    auto is_snapshot = [](const fs::DirectoryEntry &entry) {
+        return (entry.type != fs::EntryType_Dir) && !std::string_view(entry.name).ends_with(".tmp");
+    };
+    auto is_newer = [](const fs::DirectoryEntry &lhs, const fs::DirectoryEntry &rhs) {
+        return std::strcmp(lhs.name, rhs.name) > 0;
+    };
+
+    for (auto &entry: d.list(is_snapshot, is_newer, max))
+        names.emplace_back(entry.name);
+    return names;
+}
+
+} // namespace bk
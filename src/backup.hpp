@@ -0,0 +1,107 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fs.hpp"
+#include "crypto.hpp"
+#include "platform.hpp"
+
+namespace bk {
+
+// Content-addressed store of save snapshots
+// Files are split in fixed-size chunks stored once under their hash (chunks/xx/<hash>), and a snapshot
+// is a manifest listing the chunks of each file (snapshots/<name>). Consecutive backups of a save only
+// differ by the chunks that changed, so that is all they cost
+//
+// Save files that have a header (X.dat with XHeader.dat) are stored decrypted: the game draws new keys
+// on every save, so the encrypted data would never deduplicate, nor compress. The header is stored as is,
+// and the keys derived from it re-encrypt the data on restore
+// Chunks are LZ4-compressed when that makes them smaller, which their stored size tells
+constexpr auto        default_root = "/switch/Turnips/backups";
+constexpr std::size_t chunk_size   = 0x10000;
+
+// Chunks read, hashed and compressed together
+constexpr std::size_t batch_chunks = 16;
+
+struct FileEntry {
+    std::string           path;
+    std::size_t           size;
+    std::string           header; // Header holding the keys of the file, if it is stored decrypted
+    std::vector<sv::Hash> chunks;
+};
+
+struct Snapshot {
+    std::string            name;
+    std::vector<FileEntry> files;
+
+    inline std::size_t total_size() const {
+        std::size_t size = 0;
+        for (auto &file: this->files)
+            size += file.size;
+        return size;
+    }
+};
+
+struct BackupStats {
+    std::size_t num_files = 0, total_size = 0;
+    std::size_t num_chunks = 0, new_chunks = 0, new_size = 0;
+    std::size_t stored_size = 0; // Size of the new chunks after compression
+};
+
+class BackupStore {
+    private:
+        fs::Filesystem &fs;
+        std::string     root;
+
+    public:
+        BackupStore(fs::Filesystem &fs, const std::string &root = default_root): fs(fs), root(root) { }
+
+        Result initialize();
+
+        // Snapshots every file in the save filesystem
+        Result create_snapshot(fs::Filesystem &save, const std::string &name, BackupStats &stats);
+
+        // Checks every chunk of the snapshot, then writes its files back to the save filesystem, deletes the files
+        // it doesn't have, and commits it
+        Result restore_snapshot(const std::string &name, fs::Filesystem &save);
+
+        Result load_snapshot(const std::string &name, Snapshot &snapshot);
+
+        // Snapshot names, most recent first, at most `max` of them
+        std::vector<std::string> list_snapshots(std::size_t max = SIZE_MAX);
+
+    private:
+        std::string chunk_path(const sv::Hash &hash) const;
+        std::string snapshot_path(const std::string &name) const;
+
+        bool   has_chunk(const sv::Hash &hash);
+        Result load_chunk(const sv::Hash &hash, std::size_t size, std::vector<std::uint8_t> &data);
+        Result store_chunk(const sv::Hash &hash, const std::uint8_t *data, std::size_t size);
+
+        Result backup_file(fs::Filesystem &save, FileEntry &entry, sv::Aes128Ctr *aes, BackupStats &stats);
+        Result restore_file(fs::Filesystem &save, const FileEntry &entry, sv::Aes128Ctr *aes);
+        Result get_file_keys(const Snapshot &snapshot, const FileEntry &entry, std::pair<sv::Key, sv::Key> &keys);
+        Result write_manifest(const Snapshot &snapshot);
+};
+
+} // namespace bk
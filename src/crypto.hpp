@@ -0,0 +1,282 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#endif
+
+#include "sead.hpp"
+
+namespace sv {
+
+using Key = std::array<std::uint8_t, 0x10>;
+
+// Size of the encryption data in mainHeader.dat, and where it is located
+constexpr std::size_t crypt_data_offset = 0x100;
+constexpr std::size_t crypt_data_size   = 0x200;
+
+// From NHSE
+inline Key get_param(const std::vector<std::uint32_t> &crypt_data, std::size_t idx) {
+    auto sead = sead::Random(crypt_data[crypt_data[idx] & 0x7f]);
+    auto roll_count = (crypt_data[crypt_data[idx + 1] & 0x7f] & 0xf) + 1;
+
+    for (std::uint32_t i = 0; i < roll_count; ++i)
+        sead.get_u64();
+
+    Key res;
+    for (std::size_t i = 0; i < res.size(); i++)
+        res[i] = sead.get_u32() >> 24;
+    return res;
+}
+
+#ifdef __SWITCH__
+
+class Aes128Ctr {
+    private:
+        Aes128CtrContext ctx;
+
+    public:
+        inline Aes128Ctr(const Key &key, const Key &ctr) {
+            aes128CtrContextCreate(&this->ctx, key.data(), ctr.data());
+        }
+
+        inline void crypt(void *dst, const void *src, std::size_t size) {
+            aes128CtrCrypt(&this->ctx, dst, src, size);
+        }
+};
+
+#else
+
+// Portable implementation for host builds, only encryption is needed for CTR mode
+class Aes128Ctr {
+    private:
+        constexpr static std::size_t block_size = 0x10, num_rounds = 10;
+
+        constexpr static std::array<std::uint8_t, 0x100> sbox = {
+            0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+            0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+            0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+            0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+            0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+            0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+            0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+            0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+            0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+            0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+            0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+            0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+            0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+            0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+            0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+            0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+        };
+
+        std::array<std::uint8_t, block_size * (num_rounds + 1)> round_keys;
+        std::array<std::uint8_t, block_size> ctr, keystream;
+        std::size_t keystream_pos = block_size;
+
+    public:
+        inline Aes128Ctr(const Key &key, const Key &ctr): ctr(ctr) {
+            this->expand_key(key);
+        }
+
+        inline void crypt(void *dst, const void *src, std::size_t size) {
+            auto *out = static_cast<std::uint8_t *>(dst);
+            auto *in  = static_cast<const std::uint8_t *>(src);
+            for (std::size_t i = 0; i < size; ++i) {
+                if (this->keystream_pos == block_size)
+                    this->next_keystream();
+                out[i] = in[i] ^ this->keystream[this->keystream_pos++];
+            }
+        }
+
+    private:
+        constexpr static inline std::uint8_t xtime(std::uint8_t x) {
+            return (x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+        }
+
+        void expand_key(const Key &key) {
+            std::memcpy(this->round_keys.data(), key.data(), block_size);
+
+            std::uint8_t rcon = 1;
+            for (std::size_t i = block_size; i < this->round_keys.size(); i += 4) {
+                std::uint8_t t[4];
+                std::memcpy(t, &this->round_keys[i - 4], 4);
+                if (i % block_size == 0) {
+                    std::uint8_t tmp = t[0];
+                    t[0] = sbox[t[1]] ^ rcon, t[1] = sbox[t[2]], t[2] = sbox[t[3]], t[3] = sbox[tmp];
+                    rcon = xtime(rcon);
+                }
+                for (std::size_t j = 0; j < 4; ++j)
+                    this->round_keys[i + j] = this->round_keys[i + j - block_size] ^ t[j];
+            }
+        }
+
+        void encrypt_block(std::uint8_t *s) const {
+            for (std::size_t i = 0; i < block_size; ++i)
+                s[i] ^= this->round_keys[i];
+
+            for (std::size_t round = 1; round <= num_rounds; ++round) {
+                // SubBytes + ShiftRows
+                std::uint8_t t[block_size];
+                for (std::size_t c = 0; c < 4; ++c)
+                    for (std::size_t r = 0; r < 4; ++r)
+                        t[4 * c + r] = sbox[s[4 * ((c + r) % 4) + r]];
+
+                // MixColumns, skipped on the last round
+                if (round != num_rounds) {
+                    for (std::size_t c = 0; c < 4; ++c) {
+                        auto *col = &t[4 * c];
+                        std::uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3], first = col[0];
+                        col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                        col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                        col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                        col[3] ^= all ^ xtime(col[3] ^ first);
+                    }
+                }
+
+                for (std::size_t i = 0; i < block_size; ++i)
+                    s[i] = t[i] ^ this->round_keys[round * block_size + i];
+            }
+        }
+
+        void next_keystream() {
+            this->keystream = this->ctr;
+            this->encrypt_block(this->keystream.data());
+            this->keystream_pos = 0;
+
+            // Big-endian 128-bit increment
+            for (std::size_t i = block_size; i-- > 0;)
+                if (++this->ctr[i])
+                    break;
+        }
+};
+
+#endif // __SWITCH__
+
+using Hash = std::array<std::uint8_t, 0x20>;
+
+#ifdef __SWITCH__
+
+inline Hash sha256(const void *data, std::size_t size) {
+    Hash res;
+    sha256CalculateHash(res.data(), data, size);
+    return res;
+}
+
+#else
+
+// Portable implementation for host builds
+class Sha256 {
+    private:
+        constexpr static std::size_t block_size = 0x40;
+
+        constexpr static std::array<std::uint32_t, 64> round_constants = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        std::array<std::uint32_t, 8> state = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+        };
+        std::array<std::uint8_t, block_size> buf;
+        std::size_t buf_pos = 0;
+        std::uint64_t total = 0;
+
+    public:
+        inline void update(const void *data, std::size_t size) {
+            auto *in = static_cast<const std::uint8_t *>(data);
+            this->total += size;
+            while (size) {
+                auto count = std::min(size, block_size - this->buf_pos);
+                std::memcpy(&this->buf[this->buf_pos], in, count);
+                this->buf_pos += count, in += count, size -= count;
+                if (this->buf_pos == block_size)
+                    this->process_block(this->buf.data()), this->buf_pos = 0;
+            }
+        }
+
+        inline Hash finish() {
+            auto bits = this->total * 8;
+            std::uint8_t pad = 0x80;
+            this->update(&pad, 1);
+            pad = 0;
+            while (this->buf_pos != block_size - sizeof(bits))
+                this->update(&pad, 1);
+            for (std::size_t i = sizeof(bits); i-- > 0;) {
+                std::uint8_t b = bits >> (i * 8);
+                this->update(&b, 1);
+            }
+
+            Hash res;
+            for (std::size_t i = 0; i < this->state.size(); ++i)
+                for (std::size_t j = 0; j < 4; ++j)
+                    res[4 * i + j] = this->state[i] >> (24 - 8 * j);
+            return res;
+        }
+
+    private:
+        constexpr static inline std::uint32_t rotr(std::uint32_t x, unsigned n) {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        void process_block(const std::uint8_t *block) {
+            std::uint32_t w[64];
+            for (std::size_t i = 0; i < 16; ++i)
+                w[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+            for (std::size_t i = 16; i < 64; ++i) {
+                auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2],  19) ^ (w[i - 2]  >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            auto [a, b, c, d, e, f, g, h] = this->state;
+            for (std::size_t i = 0; i < 64; ++i) {
+                auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + round_constants[i] + w[i];
+                auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
+            }
+
+            std::uint32_t res[] = { a, b, c, d, e, f, g, h };
+            for (std::size_t i = 0; i < this->state.size(); ++i)
+                this->state[i] += res[i];
+        }
+};
+
+inline Hash sha256(const void *data, std::size_t size) {
+    Sha256 ctx;
+    ctx.update(data, size);
+    return ctx.finish();
+}
+
+#endif // __SWITCH__
+
+} // namespace sv
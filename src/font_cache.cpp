@@ -0,0 +1,133 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "font_cache.hpp"
+#include "lz4.hpp"
+
+namespace fc {
+
+namespace {
+
+constexpr std::uint32_t magic   = 0x41465054; // "TPFA"
+constexpr std::uint32_t version = 1;
+
+// Followed by the glyphs, then the compressed pixels
+struct Header {
+    std::uint32_t magic, version;
+    Key           key;
+    std::uint32_t tex_width, tex_height, packed_size, num_glyphs;
+    float         font_size, ascent, descent;
+    std::uint32_t fallback_char, ellipsis_char;
+    ImVec2        uv_white_pixel;
+    ImVec4        uv_lines[IM_DRAWLIST_TEX_LINES_WIDTH_MAX + 1];
+};
+
+} // namespace
+
+bool load(const char *path, const Key &key, ImFontAtlas &atlas) {
+    auto *fp = std::fopen(path, "rb");
+    if (!fp)
+        return false;
+
+    Header hdr;
+    std::vector<ImFontGlyph>  glyphs;
+    std::vector<std::uint8_t> packed;
+    auto is_valid = [&] {
+        if ((std::fread(&hdr, sizeof(hdr), 1, fp) != 1) || (hdr.magic != magic) || (hdr.version != version) || (hdr.key != key))
+            return false;
+        glyphs.resize(hdr.num_glyphs), packed.resize(hdr.packed_size);
+        return (std::fread(glyphs.data(), sizeof(ImFontGlyph), glyphs.size(), fp) == glyphs.size()) &&
+            (std::fread(packed.data(), 1, packed.size(), fp) == packed.size());
+    }();
+    std::fclose(fp);
+    if (!is_valid)
+        return false;
+
+    std::size_t tex_size = hdr.tex_width * hdr.tex_height;
+    auto *pixels = static_cast<unsigned char *>(IM_ALLOC(tex_size));
+    if (!lz::decompress(packed.data(), packed.size(), pixels, tex_size)) {
+        IM_FREE(pixels);
+        return false;
+    }
+
+    atlas.Clear();
+    atlas.TexPixelsAlpha8 = pixels;
+    atlas.TexWidth        = hdr.tex_width;
+    atlas.TexHeight       = hdr.tex_height;
+    atlas.TexUvScale      = ImVec2(1.0f / hdr.tex_width, 1.0f / hdr.tex_height);
+    atlas.TexUvWhitePixel = hdr.uv_white_pixel;
+    std::memcpy(atlas.TexUvLines, hdr.uv_lines, sizeof(hdr.uv_lines));
+
+    auto *font = IM_NEW(ImFont);
+    font->ContainerAtlas = &atlas;
+    font->FontSize       = hdr.font_size;
+    font->Ascent         = hdr.ascent;
+    font->Descent        = hdr.descent;
+    font->FallbackChar   = static_cast<ImWchar>(hdr.fallback_char);
+    font->EllipsisChar   = static_cast<ImWchar>(hdr.ellipsis_char);
+    font->Glyphs.resize(glyphs.size());
+    std::memcpy(font->Glyphs.Data, glyphs.data(), glyphs.size() * sizeof(ImFontGlyph));
+    font->BuildLookupTable();
+    atlas.Fonts.push_back(font);
+
+    return true;
+}
+
+bool store(const char *path, const Key &key, const ImFontAtlas &atlas) {
+    if ((atlas.Fonts.Size != 1) || !atlas.TexPixelsAlpha8)
+        return false;
+
+    auto &font  = *atlas.Fonts[0];
+    auto packed = lz::compress(atlas.TexPixelsAlpha8, atlas.TexWidth * atlas.TexHeight);
+
+    Header hdr = {};
+    hdr.magic          = magic;
+    hdr.version        = version;
+    hdr.key            = key;
+    hdr.tex_width      = atlas.TexWidth;
+    hdr.tex_height     = atlas.TexHeight;
+    hdr.packed_size    = packed.size();
+    hdr.num_glyphs     = font.Glyphs.Size;
+    hdr.font_size      = font.FontSize;
+    hdr.ascent         = font.Ascent;
+    hdr.descent        = font.Descent;
+    hdr.fallback_char  = font.FallbackChar;
+    hdr.ellipsis_char  = font.EllipsisChar;
+    hdr.uv_white_pixel = atlas.TexUvWhitePixel;
+    std::memcpy(hdr.uv_lines, atlas.TexUvLines, sizeof(hdr.uv_lines));
+
+    auto *fp = std::fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    auto is_written = (std::fwrite(&hdr, sizeof(hdr), 1, fp) == 1) &&
+        (std::fwrite(font.Glyphs.Data, sizeof(ImFontGlyph), font.Glyphs.Size, fp) == static_cast<std::size_t>(font.Glyphs.Size)) &&
+        (std::fwrite(packed.data(), 1, packed.size(), fp) == packed.size());
+
+    // Don't leave a truncated entry behind
+    if ((std::fclose(fp) != 0) || !is_written) {
+        std::remove(path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace fc
@@ -0,0 +1,76 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <imgui.h>
+
+#include "crypto.hpp"
+
+namespace fc {
+
+// Cache of built font atlases on the SD card: the rasterized pixels (LZ4-compressed) and the glyph table of the
+// merged font, loaded back without running ImFontAtlas::Build
+// Entries are keyed by a hash of everything the atlas depends on, so a stale entry is rebuilt and overwritten
+using Key = sv::Hash;
+
+class KeyBuilder {
+    private:
+        std::vector<std::uint8_t> data;
+
+    public:
+        // The layout of the ImGui structures is part of the key
+        inline KeyBuilder() {
+            this->add(IMGUI_VERSION_NUM).add(sizeof(ImFont)).add(sizeof(ImFontGlyph));
+        }
+
+        template <typename T>
+        inline KeyBuilder &add(const T *values, std::size_t count) {
+            auto size = this->data.size();
+            this->data.resize(size + count * sizeof(T));
+            std::memcpy(this->data.data() + size, values, count * sizeof(T));
+            return *this;
+        }
+
+        template <typename T>
+        inline KeyBuilder &add(const T &value) {
+            return this->add(&value, 1);
+        }
+
+        // Zero-terminated glyph range list
+        inline KeyBuilder &add_ranges(const ImWchar *ranges) {
+            auto count = std::size_t(0);
+            while (ranges[count])
+                ++count;
+            return this->add(ranges, count);
+        }
+
+        inline Key finish() const {
+            return sv::sha256(this->data.data(), this->data.size());
+        }
+};
+
+// Replaces the contents of the atlas with the cache entry, if it exists and matches the key
+bool load(const char *path, const Key &key, ImFontAtlas &atlas);
+
+// The atlas must be built, with a single (merged) font
+bool store(const char *path, const Key &key, const ImFontAtlas &atlas);
+
+} // namespace fc
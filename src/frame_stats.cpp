@@ -0,0 +1,256 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <numeric>
+
+#include "frame_stats.hpp"
+
+namespace pf {
+
+namespace {
+
+constexpr auto num_phases = static_cast<std::size_t>(Phase::Count);
+
+// Bucket i of the dumped histograms holds the frames that took [2^i, 2^(i+1)) ns
+constexpr std::size_t num_buckets = 32;
+
+using Samples = std::array<std::uint32_t, history_size>;
+
+// Sample i of every buffer is from the same frame, `head` is the next one to be overwritten
+std::array<Samples, num_phases> phase_samples = {};
+Samples                         alloc_samples = {};
+std::size_t                     head = 0, num_frames = 0;
+
+std::array<std::uint64_t, num_phases> current = {};
+std::uint64_t                         frame_start = 0, frame_allocs = 0;
+std::atomic<std::uint64_t>            allocations = 0;
+
+// Sorted copy of the samples in the history
+Samples get_sorted(const Samples &samples) {
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.begin() + num_frames);
+    return sorted;
+}
+
+std::uint32_t get_percentile(const Samples &sorted, double fraction) {
+    return num_frames ? sorted[std::min(num_frames - 1, static_cast<std::size_t>(fraction * num_frames))] : 0;
+}
+
+} // namespace
+
+void record(Phase phase, std::uint64_t ns) {
+    current[static_cast<std::size_t>(phase)] += ns;
+}
+
+#ifdef ALLOC_STATS
+
+void count_allocation() {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#endif
+
+void begin_frame() {
+    current      = {};
+    frame_start  = now_ns();
+    frame_allocs = allocations.load(std::memory_order_relaxed);
+}
+
+void end_frame() {
+    record(Phase::Frame, now_ns() - frame_start);
+
+    for (std::size_t i = 0; i < num_phases; ++i)
+        phase_samples[i][head] = std::min<std::uint64_t>(current[i], UINT32_MAX);
+    alloc_samples[head] = allocations.load(std::memory_order_relaxed) - frame_allocs;
+
+    head = (head + 1) % history_size, num_frames = std::min(num_frames + 1, history_size);
+}
+
+std::size_t get_num_frames() {
+    return num_frames;
+}
+
+PhaseStats get(Phase phase) {
+    auto sorted = get_sorted(phase_samples[static_cast<std::size_t>(phase)]);
+    auto total  = std::accumulate(sorted.begin(), sorted.begin() + num_frames, std::uint64_t(0));
+    return {
+        num_frames ? total / 1e6 / num_frames : 0.0,
+        get_percentile(sorted, 0.5) / 1e6, get_percentile(sorted, 0.99) / 1e6, get_percentile(sorted, 1.0) / 1e6,
+    };
+}
+
+AllocStats get_allocations() {
+    auto sorted = get_sorted(alloc_samples);
+    auto total  = std::accumulate(sorted.begin(), sorted.begin() + num_frames, std::uint64_t(0));
+    return {
+        num_frames ? static_cast<double>(total) / num_frames : 0.0,
+        get_percentile(sorted, 0.99), get_percentile(sorted, 1.0),
+    };
+}
+
+void dump(std::FILE *fp) {
+    std::fprintf(fp, "%zu frames\n\n", num_frames);
+
+    std::fprintf(fp, "%-12s %9s %9s %9s %9s\n", "phase", "avg ms", "p50 ms", "p99 ms", "max ms");
+    for (std::size_t i = 0; i < num_phases; ++i) {
+        auto s = get(static_cast<Phase>(i));
+        std::fprintf(fp, "%-12s %9.3f %9.3f %9.3f %9.3f\n", phase_names[i], s.avg_ms, s.p50_ms, s.p99_ms, s.max_ms);
+    }
+
+    if (counts_allocations) {
+        auto a = get_allocations();
+        std::fprintf(fp, "\nallocations per frame: %.1f avg, %u p99, %u max\n", a.avg, a.p99, a.max);
+    } else {
+        std::fprintf(fp, "\nallocations not counted, build with ALLOC_STATS=1\n");
+    }
+
+    for (std::size_t i = 0; i < num_phases; ++i) {
+        std::array<std::uint32_t, num_buckets> buckets = {};
+        for (std::size_t j = 0; j < num_frames; ++j)
+            if (auto ns = phase_samples[i][j]; ns)
+                ++buckets[std::min(num_buckets - 1, static_cast<std::size_t>(31 - __builtin_clz(ns)))];
+
+        std::fprintf(fp, "\n%s:\n", phase_names[i]);
+        for (std::size_t j = 0; j < num_buckets; ++j)
+            if (buckets[j])
+                std::fprintf(fp, "  < %9.3fms %6u\n", (std::uint64_t(2) << j) / 1e6, buckets[j]);
+    }
+}
+
+bool dump(const std::string &path) {
+    auto *fp = std::fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+    dump(fp);
+    std::fclose(fp);
+    return true;
+}
+
+} // namespace pf
+
+#ifdef ALLOC_STATS
+
+// Counts every C++ heap allocation of the application, with all the replaceable forms of operator new. Sized and
+// aligned deletes go to free, since both kinds of allocations come from malloc and aligned_alloc
+namespace {
+
+void *allocate(std::size_t size) {
+    pf::count_allocation();
+    return std::malloc(size ? size : 1);
+}
+
+void *allocate(std::size_t size, std::align_val_t align) {
+    pf::count_allocation();
+    // aligned_alloc wants a multiple of the alignment
+    auto al = static_cast<std::size_t>(align);
+    return std::aligned_alloc(al, (std::max<std::size_t>(size, 1) + al - 1) & ~(al - 1));
+}
+
+void *check(void *ptr) {
+    // Built without exceptions, so there is no bad_alloc to throw
+    if (!ptr)
+        std::abort();
+    return ptr;
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    return check(allocate(size));
+}
+
+void *operator new[](std::size_t size) {
+    return check(allocate(size));
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return check(allocate(size, align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align) {
+    return check(allocate(size, align));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return allocate(size, align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return allocate(size, align);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    std::free(ptr);
+}
+
+#endif // ALLOC_STATS
@@ -0,0 +1,104 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <string>
+
+#include "platform.hpp"
+
+// Frame-phase profiler: CPU time spent in each phase of the last frames, and the heap allocations made per frame
+// The timers cost two tick reads per phase, so they are always compiled in. The overlay and the dump are optional
+// Allocations are only counted in builds with ALLOC_STATS=1, which replace the global operator new and delete
+namespace pf {
+
+enum class Phase {
+    NewFrame,    // Input and ImGui::NewFrame
+    Tabs,        // Building the main window and its tabs
+    ImGuiRender, // ImGui::Render
+    Draw,        // Recording and submitting the draw lists (imgui::deko3d::render)
+    Present,
+    Frame,       // Whole frame, without the idle wait
+    Count,
+};
+
+constexpr std::array phase_names = {
+    "new_frame", "tabs", "imgui_render", "draw", "present", "frame",
+};
+static_assert(phase_names.size() == static_cast<std::size_t>(Phase::Count));
+
+// Frames kept in the ring buffers
+constexpr std::size_t history_size = 256;
+
+struct PhaseStats {
+    double avg_ms, p50_ms, p99_ms, max_ms;
+};
+
+struct AllocStats {
+    double        avg;
+    std::uint32_t p99, max;
+};
+
+// Phases can be timed several times per frame, the times add up
+void record(Phase phase, std::uint64_t ns);
+
+#ifdef ALLOC_STATS
+
+constexpr bool counts_allocations = true;
+
+// Called by the allocation hooks (operator new and the ImGui allocator)
+void count_allocation();
+
+#else
+
+constexpr bool counts_allocations = false;
+
+inline void count_allocation() { }
+
+#endif // ALLOC_STATS
+
+void begin_frame();
+void end_frame();
+
+// Over the frames in the history
+std::size_t get_num_frames();
+PhaseStats  get(Phase phase);
+AllocStats  get_allocations();
+
+// Table of every phase, then the frame time histogram of each
+void dump(std::FILE *fp);
+bool dump(const std::string &path);
+
+// Times the enclosing scope
+class Timer {
+    private:
+        Phase         phase;
+        std::uint64_t start = now_ns();
+
+    public:
+        inline Timer(Phase phase): phase(phase) { }
+
+        inline ~Timer() {
+            record(this->phase, now_ns() - this->start);
+        }
+};
+
+} // namespace pf
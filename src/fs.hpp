@@ -18,143 +18,588 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
-#include <switch.h>
+
+#include "platform.hpp"
+#include "io_stats.hpp"
+
+#ifdef __SWITCH__
+#   include "fs_nx.hpp"
+#else
+#   include "fs_posix.hpp"
+#endif
 
 namespace fs {
 
+using DirectoryEntry = impl::DirEntry;
+using EntryType      = impl::EntryType;
+using TimeStamp      = impl::TimeStamp;
+
+using impl::OpenMode_Read;
+using impl::OpenMode_Write;
+using impl::OpenMode_Append;
+
+using impl::EntryType_Dir;
+using impl::EntryType_File;
+
+// Background thread running queued I/O jobs in submission order, so that reads overlap with compute
+// Started on the first submission, and drains its queue before exiting
+class IoWorker {
+    public:
+        struct Request {
+            std::function<std::size_t()> job;
+            std::size_t                  result = 0;
+            std::atomic_bool             done   = false;
+        };
+
+    private:
+        std::mutex              mutex;
+        std::condition_variable queue_cv, done_cv;
+        std::deque<Request *>   queue;
+        std::thread             thread;
+        bool                    should_stop = false;
+
+    public:
+        static inline IoWorker &get() {
+            static IoWorker worker;
+            return worker;
+        }
+
+        inline ~IoWorker() {
+            {
+                std::scoped_lock lk(this->mutex);
+                this->should_stop = true;
+            }
+            this->queue_cv.notify_one();
+            if (this->thread.joinable())
+                this->thread.join();
+        }
+
+        inline void submit(Request *req) {
+            {
+                std::scoped_lock lk(this->mutex);
+                if (!this->thread.joinable())
+                    this->thread = std::thread(&IoWorker::run, this);
+                this->queue.push_back(req);
+            }
+            this->queue_cv.notify_one();
+        }
+
+        inline void wait(Request *req) {
+            std::unique_lock lk(this->mutex);
+            this->done_cv.wait(lk, [req] { return req->done.load(); });
+        }
+
+    private:
+        void run() {
+            while (true) {
+                Request *req;
+                {
+                    std::unique_lock lk(this->mutex);
+                    this->queue_cv.wait(lk, [this] { return this->should_stop || !this->queue.empty(); });
+                    if (this->queue.empty())
+                        return;
+                    req = this->queue.front();
+                    this->queue.pop_front();
+                }
+
+                req->result = req->job();
+                {
+                    std::scoped_lock lk(this->mutex);
+                    req->done = true;
+                }
+                this->done_cv.notify_all();
+            }
+        }
+};
+
+// Completion handle for a job submitted to the I/O worker, waits for it on destruction
+class AsyncRead {
+    private:
+        std::unique_ptr<IoWorker::Request> req;
+
+    public:
+        AsyncRead() = default;
+
+        explicit inline AsyncRead(std::function<std::size_t()> &&job): req(std::make_unique<IoWorker::Request>()) {
+            this->req->job = std::move(job);
+            IoWorker::get().submit(this->req.get());
+        }
+
+        AsyncRead(AsyncRead &&other) = default;
+
+        inline AsyncRead &operator =(AsyncRead &&other) {
+            this->wait();
+            this->req = std::move(other.req);
+            return *this;
+        }
+
+        inline ~AsyncRead() {
+            this->wait();
+        }
+
+        inline bool is_valid() const {
+            return !!this->req;
+        }
+
+        inline bool is_done() const {
+            return !this->req || this->req->done;
+        }
+
+        // Result of the job (number of bytes read)
+        inline std::size_t wait() {
+            if (!this->req)
+                return 0;
+            if (!this->req->done)
+                IoWorker::get().wait(this->req.get());
+            return this->req->result;
+        }
+};
+
+// Byte range of a file
+struct Range {
+    std::size_t offset, size;
+};
+
+// Small LRU cache of file pages, serving repeated small reads without a round-trip to the filesystem
+// (each one is an IPC on the console)
+class PageCache {
+    public:
+        constexpr static std::size_t page_size = 0x1000;
+
+        struct Page {
+            std::size_t                            index = SIZE_MAX, valid = 0;
+            std::uint64_t                          last_use = 0;
+            std::array<std::uint8_t, page_size>    data;
+        };
+
+    private:
+        std::vector<Page> pages;
+        std::uint64_t     use_counter = 0;
+
+    public:
+        std::mutex mutex;
+
+        inline PageCache(std::size_t max_pages) {
+            this->pages.resize(std::max(max_pages, 1ul));
+        }
+
+        inline Page *find(std::size_t index) {
+            auto it = std::find_if(this->pages.begin(), this->pages.end(), [index](const Page &p) { return p.index == index; });
+            if (it == this->pages.end())
+                return nullptr;
+            it->last_use = ++this->use_counter;
+            return &*it;
+        }
+
+        // Slot for a new page, evicting the least recently used one
+        inline Page &insert(std::size_t index, const std::uint8_t *data, std::size_t valid) {
+            auto &page = *std::min_element(this->pages.begin(), this->pages.end(),
+                [](const Page &lhs, const Page &rhs) { return lhs.last_use < rhs.last_use; });
+            page.index = index, page.valid = valid, page.last_use = ++this->use_counter;
+            std::memcpy(page.data.data(), data, valid);
+            return page;
+        }
+
+        inline void invalidate(std::size_t offset, std::size_t size) {
+            auto first = offset / page_size, last = (offset + size - 1) / page_size;
+            for (auto &page: this->pages)
+                if ((page.index >= first) && (page.index <= last))
+                    page.index = SIZE_MAX, page.last_use = 0;
+        }
+};
+
+// Single-pass view of the entries of an open directory, read in fixed-size pages so that memory use doesn't
+// depend on the size of the directory. Iterating consumes the handle: reopen the directory to start over
+class EntryStream {
+    public:
+        struct Sentinel { };
+
+        class Iterator {
+            private:
+                EntryStream *stream;
+
+            public:
+                using value_type      = DirectoryEntry;
+                using difference_type = std::ptrdiff_t;
+
+                constexpr inline Iterator(EntryStream *stream = nullptr): stream(stream) { }
+
+                inline const DirectoryEntry &operator*() const {
+                    return this->stream->page[this->stream->pos];
+                }
+
+                inline const DirectoryEntry *operator->() const {
+                    return &**this;
+                }
+
+                inline Iterator &operator++() {
+                    this->stream->advance();
+                    return *this;
+                }
+
+                inline void operator++(int) {
+                    ++*this;
+                }
+
+                inline bool operator==(Sentinel) const {
+                    return this->stream->is_done();
+                }
+        };
+
+    private:
+        impl::DirHandle                   *handle;
+        std::unique_ptr<DirectoryEntry[]>  page;
+        std::size_t                        page_entries, pos = 0, len = 0;
+        Result                             rc = 0;
+
+    public:
+        inline EntryStream(impl::DirHandle *handle, std::size_t page_entries):
+            handle(handle), page(std::make_unique<DirectoryEntry[]>(page_entries)), page_entries(page_entries) {
+            this->read_page();
+        }
+
+        inline Iterator begin() {
+            return Iterator(this);
+        }
+
+        inline Sentinel end() const {
+            return {};
+        }
+
+        inline bool is_done() const {
+            return this->pos >= this->len;
+        }
+
+        // Error that ended the iteration early, if any
+        inline Result error() const {
+            return this->rc;
+        }
+
+    private:
+        inline void read_page() {
+            stats::Probe probe(stats::Op::DirRead);
+            std::int64_t total = 0;
+            if (this->rc = impl::dir_read(this->handle, &total, this->page_entries, this->page.get()); R_FAILED(this->rc))
+                total = 0;
+            this->pos = 0, this->len = total;
+        }
+
+        inline void advance() {
+            // A short page means the end of the directory was reached
+            if ((++this->pos >= this->len) && (this->len == this->page_entries))
+                this->read_page();
+        }
+};
+
 struct Directory {
-    FsDir handle = {};
+    // Entries per read when streaming, about 25KiB
+    constexpr static std::size_t default_page_entries = 32;
+
+    impl::DirHandle handle = {};
 
     constexpr inline Directory() = default;
-    constexpr inline Directory(const FsDir &handle): handle(handle) { }
+    constexpr inline Directory(const impl::DirHandle &handle): handle(handle) { }
 
     inline ~Directory() {
         this->close();
     }
 
-    inline Result open(FsFileSystem *fs, const std::string &path) {
-        auto tmp = path;
-        tmp.reserve(FS_MAX_PATH); // Fails otherwise
-        return fsFsOpenDirectory(fs, tmp.c_str(), FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, &this->handle);
+    inline Result open(impl::FsHandle *fs, const std::string &path) {
+        stats::Probe probe(stats::Op::Open);
+        return impl::dir_open(fs, path, &this->handle);
     }
 
     inline void close() {
-        fsDirClose(&this->handle);
+        impl::dir_close(&this->handle);
     }
 
     inline bool is_open() const {
-        // TODO: Better heuristic?
-        return this->handle.s.session;
+        return impl::dir_is_open(&this->handle);
     }
 
     inline std::size_t count() {
         std::int64_t count = 0;
-        fsDirGetEntryCount(&this->handle, &count);
+        impl::dir_count(&this->handle, &count);
         return count;
     }
 
-    std::vector<FsDirectoryEntry> list() {
-        std::int64_t total = 0;
-        auto c = this->count();
-        auto entries = std::vector<FsDirectoryEntry>(c);
-        fsDirRead(&this->handle, &total, c, entries.data());
+    // The stream must not outlive the directory
+    inline EntryStream entries(std::size_t page_entries = default_page_entries) {
+        return EntryStream(&this->handle, page_entries);
+    }
+
+    std::vector<DirectoryEntry> list() {
+        auto entries = std::vector<DirectoryEntry>();
+        for (auto &entry: this->entries())
+            entries.push_back(entry);
+        return entries;
+    }
+
+    // Entries accepted by `filter`, ordered by `compare`. With `max`, only the first `max` entries of that order are
+    // kept while streaming, so memory is bounded by the result rather than the directory
+    template <typename Filter, typename Compare>
+    std::vector<DirectoryEntry> list(Filter &&filter, Compare &&compare, std::size_t max = SIZE_MAX) {
+        auto entries = std::vector<DirectoryEntry>();
+        for (auto &entry: this->entries()) {
+            if (!filter(entry))
+                continue;
+
+            if (max == SIZE_MAX) {
+                entries.push_back(entry);
+                continue;
+            }
+
+            // Max-heap on `compare`: its front is the entry evicted when a better one comes in
+            if (entries.size() < max) {
+                entries.push_back(entry);
+                std::push_heap(entries.begin(), entries.end(), compare);
+            } else if (max && compare(entry, entries.front())) {
+                std::pop_heap(entries.begin(), entries.end(), compare);
+                entries.back() = entry;
+                std::push_heap(entries.begin(), entries.end(), compare);
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), compare);
         return entries;
     }
 };
 
 struct File {
-    FsFile handle = {};
+    // Reads up to this size go through the page cache, when enabled
+    constexpr static std::size_t max_cached_read = 4 * PageCache::page_size;
+
+    impl::FileHandle           handle = {};
+    std::unique_ptr<PageCache> cache;
 
     constexpr inline File() = default;
-    constexpr inline File(const FsFile &handle): handle(handle) { }
+    constexpr inline File(const impl::FileHandle &handle): handle(handle) { }
 
     inline ~File() {
         this->close();
     }
 
-    inline Result open(FsFileSystem *fs, const std::string &path, std::uint32_t mode = FsOpenMode_Read) {
-        auto tmp = path;
-        tmp.reserve(FS_MAX_PATH);
-        return fsFsOpenFile(fs, tmp.c_str(), mode, &this->handle);
+    inline Result open(impl::FsHandle *fs, const std::string &path, std::uint32_t mode = OpenMode_Read) {
+        stats::Probe probe(stats::Op::Open);
+        return impl::file_open(fs, path, mode, &this->handle);
     }
 
     inline void close() {
-        fsFileClose(&this->handle);
+        this->cache.reset();
+        impl::file_close(&this->handle);
     }
 
     inline bool is_open() const {
-        return this->handle.s.session;
+        return impl::file_is_open(&this->handle);
+    }
+
+    // Serve small reads from a cache of recently read pages
+    inline void enable_cache(std::size_t max_pages = 16) {
+        this->cache = std::make_unique<PageCache>(std::max(max_pages, max_cached_read / PageCache::page_size + 1));
     }
 
     inline std::size_t size() {
         std::int64_t tmp = 0;
-        fsFileGetSize(&this->handle, &tmp);
+        impl::file_get_size(&this->handle, &tmp);
         return tmp;
     }
 
-    inline void size(std::size_t size) {
-        fsFileSetSize(&this->handle, static_cast<std::int64_t>(size));
+    inline Result size(std::size_t size) {
+        return impl::file_set_size(&this->handle, static_cast<std::int64_t>(size));
     }
 
     inline std::size_t read(void *buf, std::size_t size, std::size_t offset = 0) {
+        if (this->cache && size && (size <= max_cached_read)) {
+            stats::Probe probe(stats::Op::CachedRead);
+            auto read = this->read_cached(buf, size, offset);
+            probe.set_bytes(read);
+            return read;
+        }
+        return this->read_direct(buf, size, offset);
+    }
+
+    // Loads the given ranges into the page cache ahead of the reads that need them
+    // Ranges closer than `gap` are merged, so the whole batch costs as few reads as possible
+    // The batch should fit in the cache, or its first pages get evicted again
+    inline void read_ranges(std::vector<Range> ranges, std::size_t gap = PageCache::page_size) {
+        if (!this->cache || ranges.empty())
+            return;
+
+        std::sort(ranges.begin(), ranges.end(), [](const Range &lhs, const Range &rhs) { return lhs.offset < rhs.offset; });
+
+        auto merged = ranges.front();
+        auto flush = [this](const Range &r) {
+            std::scoped_lock lk(this->cache->mutex);
+            this->load_pages(r.offset / PageCache::page_size, (r.offset + r.size - 1) / PageCache::page_size);
+        };
+        for (auto it = ranges.begin() + 1; it != ranges.end(); ++it) {
+            if (it->offset <= merged.offset + merged.size + gap) {
+                merged.size = std::max(merged.offset + merged.size, it->offset + it->size) - merged.offset;
+            } else {
+                flush(merged);
+                merged = *it;
+            }
+        }
+        flush(merged);
+    }
+
+    // Queues a read on the I/O worker, the file and buffer must outlive the returned handle
+    inline AsyncRead read_async(void *buf, std::size_t size, std::size_t offset = 0) {
+        return AsyncRead([this, buf, size, offset] { return this->read(buf, size, offset); });
+    }
+
+    // Hints that a range will be read soon, so the backend can start fetching it
+    inline void prefetch(std::size_t offset, std::size_t size) {
+        impl::file_prefetch(&this->handle, static_cast<std::int64_t>(offset), static_cast<std::int64_t>(size));
+    }
+
+    // Read-only view of the whole file without copying it, empty if the backend can't map files
+    // The view stays valid until the file is closed or unmapped
+    inline std::span<const std::uint8_t> map(bool sequential = false) {
+        stats::Probe probe(stats::Op::Map);
+        auto size = this->size();
+        auto *ptr = impl::file_map(&this->handle, size, sequential);
+        probe.set_bytes(ptr ? size : 0);
+        return ptr ? std::span(static_cast<const std::uint8_t *>(ptr), size) : std::span<const std::uint8_t>();
+    }
+
+    inline void unmap() {
+        impl::file_unmap(&this->handle);
+    }
+
+    inline Result write(const void *buf, std::size_t size, std::size_t offset = 0) {
+        if (this->cache && size) {
+            std::scoped_lock lk(this->cache->mutex);
+            this->cache->invalidate(offset, size);
+        }
+        stats::Probe probe(stats::Op::Write, size);
+        return impl::file_write(&this->handle, static_cast<std::int64_t>(offset), buf, size);
+    }
+
+    inline Result flush() {
+        stats::Probe probe(stats::Op::Flush);
+        return impl::file_flush(&this->handle);
+    }
+
+    inline std::size_t read_direct(void *buf, std::size_t size, std::size_t offset) {
+        stats::Probe probe(stats::Op::Read);
         std::uint64_t tmp = 0;
-        auto rc = fsFileRead(&this->handle, static_cast<std::int64_t>(offset), buf, static_cast<std::uint64_t>(size), FsReadOption_None, &tmp);
+        auto rc = impl::file_read(&this->handle, static_cast<std::int64_t>(offset), buf, static_cast<std::uint64_t>(size), &tmp);
+        probe.set_bytes(tmp);
         if (R_FAILED(rc))
             printf("Read failed with %#x\n", rc);
         return tmp;
     }
 
-    inline void write(const void *buf, std::size_t size, std::size_t offset = 0) {
-        fsFileWrite(&this->handle, static_cast<std::int64_t>(offset), buf, size, FsWriteOption_None);
+    // Reads the missing pages in [first, last], with one read per contiguous run
+    void load_pages(std::size_t first, std::size_t last) {
+        std::vector<std::uint8_t> tmp;
+        for (auto index = first; index <= last;) {
+            if (this->cache->find(index)) {
+                ++index;
+                continue;
+            }
+
+            auto end = index + 1;
+            while ((end <= last) && !this->cache->find(end))
+                ++end;
+
+            tmp.resize((end - index) * PageCache::page_size);
+            auto read = this->read_direct(tmp.data(), tmp.size(), index * PageCache::page_size);
+            for (auto i = index; i < end; ++i) {
+                auto pos = (i - index) * PageCache::page_size;
+                this->cache->insert(i, &tmp[pos], (read > pos) ? std::min(read - pos, PageCache::page_size) : 0);
+            }
+            index = end;
+        }
     }
 
-    inline void flush() {
-        fsFileFlush(&this->handle);
+    std::size_t read_cached(void *buf, std::size_t size, std::size_t offset) {
+        std::scoped_lock lk(this->cache->mutex);
+        auto first = offset / PageCache::page_size, last = (offset + size - 1) / PageCache::page_size;
+        this->load_pages(first, last);
+
+        auto *out = static_cast<std::uint8_t *>(buf);
+        std::size_t done = 0;
+        for (auto index = first; index <= last; ++index) {
+            auto *page = this->cache->find(index);
+            if (!page) // Evicted, the cache is smaller than the range
+                return done + this->read_direct(out + done, size - done, offset + done);
+
+            auto pos   = (offset + done) - index * PageCache::page_size;
+            auto count = std::min(size - done, (page->valid > pos) ? page->valid - pos : 0);
+            std::memcpy(out + done, page->data.data() + pos, count);
+            done += count;
+            if (page->valid != PageCache::page_size)
+                break;
+        }
+        return done;
     }
 };
 
 struct Filesystem {
-    FsFileSystem handle = {};
+    impl::FsHandle handle = {};
 
     constexpr inline Filesystem() = default;
-    constexpr inline Filesystem(const FsFileSystem &handle): handle(handle) { }
+    constexpr inline Filesystem(const impl::FsHandle &handle): handle(handle) { }
 
     inline ~Filesystem() {
         this->close();
     }
 
+#ifdef __SWITCH__
     inline Result open(FsBisPartitionId id) {
-        return fsOpenBisFileSystem(&this->handle, id, "");
+        return impl::fs_open_bis(&this->handle, id);
     }
+#else
+    // Mounts a host directory as the root of the filesystem
+    inline Result open(const std::string &root) {
+        return impl::fs_open(&this->handle, root);
+    }
+#endif
 
     inline Result open_sdmc() {
-        return fsOpenSdCardFileSystem(&this->handle);
+        return impl::fs_open_sdmc(&this->handle);
     }
 
+    // Changes that weren't committed with flush are discarded
     inline void close() {
-        flush();
-        fsFsClose(&this->handle);
+        impl::fs_close(&this->handle);
     }
 
     inline bool is_open() const {
-        return this->handle.s.session;
+        return impl::fs_is_open(&this->handle);
     }
 
     inline Result flush() {
-        return fsFsCommit(&this->handle);
+        stats::Probe probe(stats::Op::Commit);
+        return impl::fs_commit(&this->handle);
     }
 
     inline std::size_t total_space() {
         std::int64_t tmp = 0;
-        fsFsGetTotalSpace(&this->handle, "/", &tmp);
+        impl::fs_total_space(&this->handle, &tmp);
         return tmp;
     }
 
     inline std::size_t free_space() {
         std::int64_t tmp = 0;
-        fsFsGetFreeSpace(&this->handle, "/", &tmp);
+        impl::fs_free_space(&this->handle, &tmp);
         return tmp;
     }
 
@@ -162,30 +607,41 @@ struct Filesystem {
         return d.open(&this->handle, path);
     }
 
-    inline Result open_file(File &f, const std::string &path, std::uint32_t mode = FsOpenMode_Read) {
+    inline Result open_file(File &f, const std::string &path, std::uint32_t mode = OpenMode_Read) {
         return f.open(&this->handle, path, mode);
     }
 
     inline Result create_directory(const std::string &path) {
-        return fsFsCreateDirectory(&this->handle, path.c_str());
+        stats::Probe probe(stats::Op::Create);
+        return impl::fs_create_directory(&this->handle, path);
     }
 
     inline Result create_file(const std::string &path, std::size_t size = 0) {
-        return fsFsCreateFile(&this->handle, path.c_str(), static_cast<std::int64_t>(size), 0);
+        stats::Probe probe(stats::Op::Create);
+        return impl::fs_create_file(&this->handle, path, static_cast<std::int64_t>(size));
     }
 
     inline Result copy_file(const std::string &source, const std::string &destination) {
         File source_f, dest_f;
-        if (auto rc = this->open_file(source_f, source) | this->open_file(dest_f, destination, FsOpenMode_Write); R_FAILED(rc))
+        if (auto rc = this->open_file(source_f, source) | this->open_file(dest_f, destination, OpenMode_Write); R_FAILED(rc))
             return rc;
 
         constexpr std::size_t buf_size = 0x100000; // 1 MiB
-        auto buf = std::vector<std::uint8_t>(buf_size);
+        std::array<std::vector<std::uint8_t>, 2> bufs = { std::vector<std::uint8_t>(buf_size), std::vector<std::uint8_t>(buf_size) };
 
+        // Double-buffered: the next chunk is read in the background while the current one is written
         std::size_t size = source_f.size(), offset = 0;
-        while (size) {
-            auto read = source_f.read(static_cast<void *>(buf.data()), buf_size, offset);
-            dest_f.write(buf.data(), read, offset);
+        source_f.prefetch(0, size);
+        auto pending = source_f.read_async(bufs[0].data(), std::min(size, buf_size), 0);
+        for (std::size_t i = 0; size; i ^= 1) {
+            auto read = pending.wait();
+            if (!read)
+                break;
+            if (size > read)
+                pending = source_f.read_async(bufs[i ^ 1].data(), std::min(size - read, buf_size), offset + read);
+            // The pending read is waited for when it goes out of scope
+            if (auto rc = dest_f.write(bufs[i].data(), read, offset); R_FAILED(rc))
+                return rc;
             offset += read;
             size   -= read;
         }
@@ -196,23 +652,48 @@ struct Filesystem {
         return 0;
     }
 
-    inline FsDirEntryType get_path_type(const std::string &path) {
-        FsDirEntryType type;
-        fsFsGetEntryType(&this->handle, path.c_str(), &type);
+    inline bool exists(const std::string &path) {
+        stats::Probe probe(stats::Op::Stat);
+        EntryType type;
+        return R_SUCCEEDED(impl::fs_get_entry_type(&this->handle, path, &type));
+    }
+
+    // Creates every missing directory along the path
+    inline Result create_directories(const std::string &path) {
+        for (auto pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+            auto sub = path.substr(0, pos);
+            if (!this->is_directory(sub))
+                if (auto rc = this->create_directory(sub); R_FAILED(rc))
+                    return rc;
+            if (pos == std::string::npos)
+                return 0;
+        }
+    }
+
+    inline EntryType get_path_type(const std::string &path) {
+        stats::Probe probe(stats::Op::Stat);
+        EntryType type;
+        impl::fs_get_entry_type(&this->handle, path, &type);
         return type;
     }
 
+    // Both false if the path doesn't exist
     inline bool is_directory(const std::string &path) {
-        return get_path_type(path) == FsDirEntryType_Dir;
+        stats::Probe probe(stats::Op::Stat);
+        EntryType type;
+        return R_SUCCEEDED(impl::fs_get_entry_type(&this->handle, path, &type)) && (type == impl::EntryType_Dir);
     }
 
     inline bool is_file(const std::string &path) {
-        return get_path_type(path) == FsDirEntryType_File;
+        stats::Probe probe(stats::Op::Stat);
+        EntryType type;
+        return R_SUCCEEDED(impl::fs_get_entry_type(&this->handle, path, &type)) && (type == impl::EntryType_File);
     }
 
-    inline FsTimeStampRaw get_timestamp(const std::string &path) {
-        FsTimeStampRaw ts = {};
-        fsFsGetFileTimeStampRaw(&this->handle, path.c_str(), &ts);
+    inline TimeStamp get_timestamp(const std::string &path) {
+        TimeStamp ts = {};
+        stats::Probe probe(stats::Op::Stat);
+        impl::fs_get_timestamp(&this->handle, path, &ts);
         return ts;
     }
 
@@ -225,19 +706,23 @@ struct Filesystem {
     }
 
     inline Result move_directory(const std::string &old_path, const std::string &new_path) {
-        return fsFsRenameDirectory(&this->handle, old_path.c_str(), new_path.c_str());
+        stats::Probe probe(stats::Op::Rename);
+        return impl::fs_rename_directory(&this->handle, old_path, new_path);
     }
 
     inline Result move_file(const std::string &old_path, const std::string &new_path) {
-        return fsFsRenameFile(&this->handle, old_path.c_str(), new_path.c_str());
+        stats::Probe probe(stats::Op::Rename);
+        return impl::fs_rename_file(&this->handle, old_path, new_path);
     }
 
     inline Result delete_directory(const std::string &path) {
-        return fsFsDeleteDirectoryRecursively(&this->handle, path.c_str());
+        stats::Probe probe(stats::Op::Delete);
+        return impl::fs_delete_directory(&this->handle, path);
     }
 
     inline Result delete_file(const std::string &path) {
-        return fsFsDeleteFile(&this->handle, path.c_str());
+        stats::Probe probe(stats::Op::Delete);
+        return impl::fs_delete_file(&this->handle, path);
     }
 };
 
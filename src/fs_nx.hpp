@@ -0,0 +1,171 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// libnx backend for the fs:: wrappers
+
+#include <cstdint>
+#include <string>
+#include <switch.h>
+
+namespace fs::impl {
+
+using FsHandle   = FsFileSystem;
+using DirHandle  = FsDir;
+using FileHandle = FsFile;
+using DirEntry   = FsDirectoryEntry;
+using EntryType  = FsDirEntryType;
+using TimeStamp  = FsTimeStampRaw;
+
+constexpr std::uint32_t OpenMode_Read   = FsOpenMode_Read;
+constexpr std::uint32_t OpenMode_Write  = FsOpenMode_Write;
+constexpr std::uint32_t OpenMode_Append = FsOpenMode_Append;
+
+constexpr EntryType EntryType_Dir  = FsDirEntryType_Dir;
+constexpr EntryType EntryType_File = FsDirEntryType_File;
+
+inline std::string fix_path(const std::string &path) {
+    auto tmp = path;
+    tmp.reserve(FS_MAX_PATH); // Fails otherwise
+    return tmp;
+}
+
+inline Result dir_open(FsHandle *fs, const std::string &path, DirHandle *dir) {
+    return fsFsOpenDirectory(fs, fix_path(path).c_str(), FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, dir);
+}
+
+inline void dir_close(DirHandle *dir) {
+    fsDirClose(dir);
+}
+
+inline bool dir_is_open(const DirHandle *dir) {
+    // TODO: Better heuristic?
+    return dir->s.session;
+}
+
+inline Result dir_count(DirHandle *dir, std::int64_t *count) {
+    return fsDirGetEntryCount(dir, count);
+}
+
+inline Result dir_read(DirHandle *dir, std::int64_t *total, std::size_t max, DirEntry *entries) {
+    return fsDirRead(dir, total, max, entries);
+}
+
+inline Result file_open(FsHandle *fs, const std::string &path, std::uint32_t mode, FileHandle *file) {
+    return fsFsOpenFile(fs, fix_path(path).c_str(), mode, file);
+}
+
+inline void file_close(FileHandle *file) {
+    fsFileClose(file);
+}
+
+inline bool file_is_open(const FileHandle *file) {
+    return file->s.session;
+}
+
+inline Result file_get_size(FileHandle *file, std::int64_t *size) {
+    return fsFileGetSize(file, size);
+}
+
+inline Result file_set_size(FileHandle *file, std::int64_t size) {
+    return fsFileSetSize(file, size);
+}
+
+inline Result file_read(FileHandle *file, std::int64_t offset, void *buf, std::uint64_t size, std::uint64_t *read) {
+    return fsFileRead(file, offset, buf, size, FsReadOption_None, read);
+}
+
+inline Result file_write(FileHandle *file, std::int64_t offset, const void *buf, std::uint64_t size) {
+    return fsFileWrite(file, offset, buf, size, FsWriteOption_None);
+}
+
+inline Result file_flush(FileHandle *file) {
+    return fsFileFlush(file);
+}
+
+// fsp has no readahead hint
+inline void file_prefetch(FileHandle *file, std::int64_t offset, std::int64_t size) { }
+
+// Files can't be memory-mapped through fsp, callers fall back to reads
+inline const void *file_map(FileHandle *file, std::size_t size, bool sequential) {
+    return nullptr;
+}
+
+inline void file_unmap(FileHandle *file) { }
+
+inline void fs_close(FsHandle *fs) {
+    fsFsClose(fs);
+}
+
+inline bool fs_is_open(const FsHandle *fs) {
+    return fs->s.session;
+}
+
+inline Result fs_commit(FsHandle *fs) {
+    return fsFsCommit(fs);
+}
+
+inline Result fs_total_space(FsHandle *fs, std::int64_t *size) {
+    return fsFsGetTotalSpace(fs, "/", size);
+}
+
+inline Result fs_free_space(FsHandle *fs, std::int64_t *size) {
+    return fsFsGetFreeSpace(fs, "/", size);
+}
+
+inline Result fs_create_directory(FsHandle *fs, const std::string &path) {
+    return fsFsCreateDirectory(fs, path.c_str());
+}
+
+inline Result fs_create_file(FsHandle *fs, const std::string &path, std::int64_t size) {
+    return fsFsCreateFile(fs, path.c_str(), size, 0);
+}
+
+inline Result fs_get_entry_type(FsHandle *fs, const std::string &path, EntryType *type) {
+    return fsFsGetEntryType(fs, path.c_str(), type);
+}
+
+inline Result fs_get_timestamp(FsHandle *fs, const std::string &path, TimeStamp *ts) {
+    return fsFsGetFileTimeStampRaw(fs, path.c_str(), ts);
+}
+
+inline Result fs_rename_directory(FsHandle *fs, const std::string &old_path, const std::string &new_path) {
+    return fsFsRenameDirectory(fs, old_path.c_str(), new_path.c_str());
+}
+
+inline Result fs_rename_file(FsHandle *fs, const std::string &old_path, const std::string &new_path) {
+    return fsFsRenameFile(fs, old_path.c_str(), new_path.c_str());
+}
+
+inline Result fs_delete_directory(FsHandle *fs, const std::string &path) {
+    return fsFsDeleteDirectoryRecursively(fs, path.c_str());
+}
+
+inline Result fs_delete_file(FsHandle *fs, const std::string &path) {
+    return fsFsDeleteFile(fs, path.c_str());
+}
+
+inline Result fs_open_bis(FsHandle *fs, FsBisPartitionId id) {
+    return fsOpenBisFileSystem(fs, id, "");
+}
+
+inline Result fs_open_sdmc(FsHandle *fs) {
+    return fsOpenSdCardFileSystem(fs);
+}
+
+} // namespace fs::impl
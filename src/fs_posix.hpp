@@ -0,0 +1,414 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// POSIX backend for the fs:: wrappers, so that the save pipeline can run on a (Linux) host
+// A filesystem is a directory file descriptor, and paths are resolved relative to it with the *at() calls,
+// the same way libnx paths are relative to the mounted filesystem
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+
+#include "platform.hpp"
+
+namespace fs::impl {
+
+constexpr std::size_t max_path = 0x301;
+
+struct FsHandle {
+    int fd = -1;
+};
+
+struct FileHandle {
+    int fd = -1;
+
+    // Read-only mapping of the file, if one was requested
+    void        *map      = nullptr;
+    std::size_t  map_size = 0;
+};
+
+struct DirHandle {
+    int fd = -1;
+
+    // Entries returned by the last getdents call and not handed out yet
+    std::size_t pos = 0, len = 0;
+    alignas(8) char buf[0x1000];
+};
+
+enum EntryType: std::uint8_t {
+    EntryType_Dir  = 0,
+    EntryType_File = 1,
+};
+
+// Same layout as FsDirectoryEntry
+struct DirEntry {
+    char         name[max_path];
+    std::uint8_t pad[3];
+    std::int8_t  type;
+    std::uint8_t pad2[3];
+    std::int64_t file_size;
+};
+
+struct TimeStamp {
+    std::uint64_t created, modified, accessed;
+    std::uint8_t  is_valid, pad[7];
+};
+
+constexpr std::uint32_t OpenMode_Read   = 1 << 0;
+constexpr std::uint32_t OpenMode_Write  = 1 << 1;
+constexpr std::uint32_t OpenMode_Append = 1 << 2;
+
+struct linux_dirent64 {
+    std::uint64_t  d_ino;
+    std::int64_t   d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+inline Result last_error() {
+    return errno ? errno : EIO;
+}
+
+inline std::string fix_path(const std::string &path) {
+    auto pos = path.find_first_not_of('/');
+    return (pos == std::string::npos) ? "." : path.substr(pos);
+}
+
+inline long get_dents(int fd, char *buf, std::size_t size) {
+    long res;
+    while (((res = syscall(SYS_getdents64, fd, buf, size)) < 0) && (errno == EINTR));
+    return res;
+}
+
+inline bool is_dot_entry(const char *name) {
+    return !std::strcmp(name, ".") || !std::strcmp(name, "..");
+}
+
+inline Result dir_open(FsHandle *fs, const std::string &path, DirHandle *dir) {
+    dir->pos = dir->len = 0;
+    if (dir->fd = openat(fs->fd, fix_path(path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dir->fd < 0)
+        return last_error();
+    return 0;
+}
+
+inline void dir_close(DirHandle *dir) {
+    if (dir->fd >= 0)
+        close(dir->fd);
+    dir->fd = -1;
+}
+
+inline bool dir_is_open(const DirHandle *dir) {
+    return dir->fd >= 0;
+}
+
+inline Result dir_read(DirHandle *dir, std::int64_t *total, std::size_t max, DirEntry *entries) {
+    *total = 0;
+    while (static_cast<std::size_t>(*total) < max) {
+        if (dir->pos >= dir->len) {
+            auto res = get_dents(dir->fd, dir->buf, sizeof(dir->buf));
+            if (res < 0)
+                return last_error();
+            if (res == 0)
+                break;
+            dir->pos = 0, dir->len = res;
+        }
+
+        auto *dent = reinterpret_cast<const linux_dirent64 *>(dir->buf + dir->pos);
+        dir->pos += dent->d_reclen;
+        if (is_dot_entry(dent->d_name))
+            continue;
+
+        struct stat st;
+        if (fstatat(dir->fd, dent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            continue;
+
+        auto &entry = entries[(*total)++];
+        std::memset(&entry, 0, sizeof(entry));
+        std::strncpy(entry.name, dent->d_name, sizeof(entry.name) - 1);
+        entry.type      = S_ISDIR(st.st_mode) ? EntryType_Dir : EntryType_File;
+        entry.file_size = S_ISDIR(st.st_mode) ? 0 : st.st_size;
+    }
+    return 0;
+}
+
+inline Result dir_count(DirHandle *dir, std::int64_t *count) {
+    // Separate description so the read position of the handle isn't disturbed
+    *count = 0;
+    int fd = openat(dir->fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return last_error();
+
+    alignas(8) char buf[0x1000];
+    long res;
+    while ((res = get_dents(fd, buf, sizeof(buf))) > 0) {
+        for (long pos = 0; pos < res;) {
+            auto *dent = reinterpret_cast<const linux_dirent64 *>(buf + pos);
+            pos += dent->d_reclen;
+            *count += !is_dot_entry(dent->d_name);
+        }
+    }
+    close(fd);
+    return (res < 0) ? last_error() : 0;
+}
+
+inline Result file_open(FsHandle *fs, const std::string &path, std::uint32_t mode, FileHandle *file) {
+    int flags = O_CLOEXEC;
+    if (mode & (OpenMode_Write | OpenMode_Append))
+        flags |= (mode & OpenMode_Read) ? O_RDWR : O_WRONLY;
+    else
+        flags |= O_RDONLY;
+
+    if (file->fd = openat(fs->fd, fix_path(path).c_str(), flags); file->fd < 0)
+        return last_error();
+    return 0;
+}
+
+inline void file_unmap(FileHandle *file) {
+    if (file->map)
+        munmap(file->map, file->map_size);
+    file->map = nullptr, file->map_size = 0;
+}
+
+inline void file_close(FileHandle *file) {
+    file_unmap(file);
+    if (file->fd >= 0)
+        close(file->fd);
+    file->fd = -1;
+}
+
+inline bool file_is_open(const FileHandle *file) {
+    return file->fd >= 0;
+}
+
+inline Result file_get_size(FileHandle *file, std::int64_t *size) {
+    struct stat st;
+    if (fstat(file->fd, &st) < 0)
+        return last_error();
+    *size = st.st_size;
+    return 0;
+}
+
+inline Result file_set_size(FileHandle *file, std::int64_t size) {
+    return (ftruncate(file->fd, size) < 0) ? last_error() : 0;
+}
+
+inline Result file_read(FileHandle *file, std::int64_t offset, void *buf, std::uint64_t size, std::uint64_t *read) {
+    *read = 0;
+    while (*read < size) {
+        auto res = pread(file->fd, static_cast<std::uint8_t *>(buf) + *read, size - *read, offset + *read);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return last_error();
+        }
+        if (res == 0)
+            break;
+        *read += res;
+    }
+    return 0;
+}
+
+inline Result file_write(FileHandle *file, std::int64_t offset, const void *buf, std::uint64_t size) {
+    std::uint64_t written = 0;
+    while (written < size) {
+        auto res = pwrite(file->fd, static_cast<const std::uint8_t *>(buf) + written, size - written, offset + written);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return last_error();
+        }
+        written += res;
+    }
+    return 0;
+}
+
+inline Result file_flush(FileHandle *file) {
+    return (fdatasync(file->fd) < 0) ? last_error() : 0;
+}
+
+inline void file_prefetch(FileHandle *file, std::int64_t offset, std::int64_t size) {
+    posix_fadvise(file->fd, offset, size, POSIX_FADV_WILLNEED);
+}
+
+// Maps the first `size` bytes of the file, the mapping is kept until the file is closed
+// For sequential consumers, the kernel is told to read ahead aggressively and drop pages behind
+inline const void *file_map(FileHandle *file, std::size_t size, bool sequential) {
+    if (file->map && (file->map_size >= size))
+        return file->map;
+    file_unmap(file);
+
+    if (!size)
+        return nullptr;
+    auto *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED)
+        return nullptr;
+
+    if (sequential) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        readahead(file->fd, 0, size);
+    }
+
+    file->map = map, file->map_size = size;
+    return map;
+}
+
+inline Result fs_open(FsHandle *fs, const std::string &root) {
+    if (fs->fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); fs->fd < 0)
+        return last_error();
+    return 0;
+}
+
+// $TURNIPS_SDMC stands in for the SD card, defaults to ./sdmc
+inline Result fs_open_sdmc(FsHandle *fs) {
+    auto *root = std::getenv("TURNIPS_SDMC");
+    return fs_open(fs, root ? root : "sdmc");
+}
+
+inline void fs_close(FsHandle *fs) {
+    if (fs->fd >= 0)
+        close(fs->fd);
+    fs->fd = -1;
+}
+
+inline bool fs_is_open(const FsHandle *fs) {
+    return fs->fd >= 0;
+}
+
+inline Result fs_commit(FsHandle *fs) {
+    if (fs->fd < 0)
+        return EBADF;
+    return (fsync(fs->fd) < 0) ? last_error() : 0;
+}
+
+inline Result fs_total_space(FsHandle *fs, std::int64_t *size) {
+    struct statvfs st;
+    if (fstatvfs(fs->fd, &st) < 0)
+        return last_error();
+    *size = static_cast<std::int64_t>(st.f_blocks) * st.f_frsize;
+    return 0;
+}
+
+inline Result fs_free_space(FsHandle *fs, std::int64_t *size) {
+    struct statvfs st;
+    if (fstatvfs(fs->fd, &st) < 0)
+        return last_error();
+    *size = static_cast<std::int64_t>(st.f_bavail) * st.f_frsize;
+    return 0;
+}
+
+inline Result fs_create_directory(FsHandle *fs, const std::string &path) {
+    return (mkdirat(fs->fd, fix_path(path).c_str(), 0755) < 0) ? last_error() : 0;
+}
+
+inline Result fs_create_file(FsHandle *fs, const std::string &path, std::int64_t size) {
+    int fd = openat(fs->fd, fix_path(path).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return last_error();
+    Result rc = (ftruncate(fd, size) < 0) ? last_error() : 0;
+    close(fd);
+    return rc;
+}
+
+inline Result fs_get_entry_type(FsHandle *fs, const std::string &path, EntryType *type) {
+    struct stat st;
+    if (fstatat(fs->fd, fix_path(path).c_str(), &st, 0) < 0)
+        return last_error();
+    *type = S_ISDIR(st.st_mode) ? EntryType_Dir : EntryType_File;
+    return 0;
+}
+
+inline Result fs_get_timestamp(FsHandle *fs, const std::string &path, TimeStamp *ts) {
+    struct stat st;
+    if (fstatat(fs->fd, fix_path(path).c_str(), &st, 0) < 0)
+        return last_error();
+    // No portable creation time, use the status change time instead
+    ts->created  = st.st_ctim.tv_sec;
+    ts->modified = st.st_mtim.tv_sec;
+    ts->accessed = st.st_atim.tv_sec;
+    ts->is_valid = 1;
+    return 0;
+}
+
+inline Result fs_rename_directory(FsHandle *fs, const std::string &old_path, const std::string &new_path) {
+    return (renameat(fs->fd, fix_path(old_path).c_str(), fs->fd, fix_path(new_path).c_str()) < 0) ? last_error() : 0;
+}
+
+inline Result fs_rename_file(FsHandle *fs, const std::string &old_path, const std::string &new_path) {
+    return fs_rename_directory(fs, old_path, new_path);
+}
+
+inline Result remove_tree(int parent_fd, const char *path) {
+    int fd = openat(parent_fd, path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return last_error();
+
+    // Collect names first, getdents doesn't define what happens when entries are removed mid-iteration
+    std::vector<std::pair<std::string, bool>> children;
+    alignas(8) char buf[0x1000];
+    long res;
+    while ((res = get_dents(fd, buf, sizeof(buf))) > 0) {
+        for (long pos = 0; pos < res;) {
+            auto *dent = reinterpret_cast<const linux_dirent64 *>(buf + pos);
+            pos += dent->d_reclen;
+            if (is_dot_entry(dent->d_name))
+                continue;
+
+            bool is_dir = dent->d_type == DT_DIR;
+            if (struct stat st; dent->d_type == DT_UNKNOWN)
+                is_dir = !fstatat(fd, dent->d_name, &st, AT_SYMLINK_NOFOLLOW) && S_ISDIR(st.st_mode);
+            children.emplace_back(dent->d_name, is_dir);
+        }
+    }
+
+    Result rc = (res < 0) ? last_error() : 0;
+    for (auto &[name, is_dir]: children) {
+        if (R_FAILED(rc))
+            break;
+        if (is_dir)
+            rc = remove_tree(fd, name.c_str());
+        else if (unlinkat(fd, name.c_str(), 0) < 0)
+            rc = last_error();
+    }
+    close(fd);
+
+    if (R_SUCCEEDED(rc) && (unlinkat(parent_fd, path, AT_REMOVEDIR) < 0))
+        rc = last_error();
+    return rc;
+}
+
+inline Result fs_delete_directory(FsHandle *fs, const std::string &path) {
+    return remove_tree(fs->fd, fix_path(path).c_str());
+}
+
+inline Result fs_delete_file(FsHandle *fs, const std::string &path) {
+    return (unlinkat(fs->fd, fix_path(path).c_str(), 0) < 0) ? last_error() : 0;
+}
+
+} // namespace fs::impl
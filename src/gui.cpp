@@ -16,9 +16,17 @@
 // along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
 #include <switch.h>
 #include <imgui.h>
 #include <nvjpg.hpp>
@@ -27,6 +35,9 @@
 
 #include "gui.hpp"
 #include "lang.hpp"
+#include "lang_names.h"
+#include "frame_stats.hpp"
+#include "startup_trace.hpp"
 
 #include "theme.hpp"
 
@@ -36,16 +47,27 @@ namespace gui {
 
 namespace {
 
-constexpr std::uint32_t BG_IMAGE_ID   = 1;
-constexpr std::uint32_t BG_SAMPLER_ID = 1;
+constexpr auto NUM_FONT_SCRIPTS = static_cast<std::uint32_t>(imgui::nx::FontScript::Count);
+
+// One font image per script, uploaded when the atlas is built
+constexpr std::uint32_t FONT_IMAGE_ID   = 0;
+constexpr std::uint32_t FONT_SAMPLER_ID = 0;
+
+constexpr std::uint32_t BG_IMAGE_ID     = FONT_IMAGE_ID + NUM_FONT_SCRIPTS;
+constexpr std::uint32_t BG_SAMPLER_ID   = 1;
 
 constexpr auto MAX_SAMPLERS = 2;
-constexpr auto MAX_IMAGES   = 2;
+constexpr auto MAX_IMAGES   = NUM_FONT_SCRIPTS + 1;
 
 constexpr auto FB_NUM       = 2u;
 
 constexpr auto CMDBUF_SIZE  = 1024 * 1024;
 
+// Frames keep being drawn for a while after the last event, for ImGui's transitions and navigation
+constexpr std::uint64_t ACTIVE_NS = 500'000'000;
+// Input sampling interval while idle: buttons and touches don't signal any event
+constexpr std::uint64_t POLL_NS   = 16'666'666;
+
 unsigned s_width  = 1920;
 unsigned s_height = 1080;
 
@@ -69,6 +91,42 @@ dk::ImageDescriptor   *s_imageDescriptors   = nullptr;
 dk::UniqueQueue        s_queue;
 dk::UniqueSwapchain    s_swapchain;
 
+std::uint64_t          s_maxIdleNs     = DEFAULT_MAX_IDLE_NS;
+std::uint64_t          s_lastEventNs   = 0;
+std::uint64_t          s_lastFrameNs   = 0;
+std::uint64_t          s_startNs       = 0;
+std::uint64_t          s_startCpuNs    = 0;
+std::uint64_t          s_idleNs        = 0;
+std::uint32_t          s_numFrames     = 0;
+std::uint32_t          s_numWakes      = 0;
+
+// Signaled by background jobs, so that their result is drawn without waiting for input
+UEvent                 s_wakeEvent;
+
+bool                   s_showProfiler  = false;
+
+imgui::nx::FontScript  s_fontScript    = imgui::nx::FontScript::Latin;
+
+// Backups hash, compress and write the whole save, which takes seconds on the SD card: they run on their own
+// thread (not the I/O worker, which serves their reads), and wake the main loop when done
+struct BackupJob {
+    enum class Kind {
+        Create,
+        Restore,
+    };
+
+    Kind             kind;
+    std::string      name;
+    Result           rc    = 0;
+    bk::BackupStats  stats = {};
+    std::atomic_bool done  = false;
+    std::thread      thread;
+};
+
+std::unique_ptr<BackupJob> s_backupJob;
+std::array<char, 0x100>    s_backupStatus = {};
+bool                       s_needsSnapshotRefresh = true;
+
 void rebuildSwapchain(unsigned const width_, unsigned const height_) {
     // destroy old swapchain
     s_swapchain = nullptr;
@@ -195,31 +253,323 @@ void deko3dExit() {
     s_device        = nullptr;
 }
 
+imgui::nx::FontScript get_font_script(lang::Language lang) {
+    switch (lang) {
+        case lang::Language::ChineseSimplified:
+        case lang::Language::ChineseTraditional:
+        case lang::Language::Japanese:
+        case lang::Language::JapaneseRyukyuan:
+            return imgui::nx::FontScript::Chinese;
+        case lang::Language::Korean:
+            return imgui::nx::FontScript::Korean;
+        default:
+            return imgui::nx::FontScript::Latin;
+    }
+}
+
+DkResHandle get_font_texture_handle(imgui::nx::FontScript script) {
+    return dkMakeTextureHandle(FONT_IMAGE_ID + static_cast<std::uint32_t>(script), FONT_SAMPLER_ID);
+}
+
+// CPU time of the calling thread, on all cores
+std::uint64_t get_cpu_time_ns() {
+    u64 ticks = 0;
+    svcGetInfo(&ticks, InfoType_ThreadTickCount, CUR_THREAD_HANDLE, UINT64_MAX);
+    return armTicksToNs(ticks);
+}
+
+// Switches to the atlas of the script, uploading it if it was just built
+void set_font_script(imgui::nx::FontScript script) {
+    s_fontScript = script;
+    if (!imgui::nx::setFontScript(script))
+        return;
+
+    // The command buffer may still be in use by the last frame
+    s_queue.waitIdle();
+    s_cmdBuf[0].clear();
+    imgui::deko3d::addFontTexture(s_device, s_queue, s_cmdBuf[0],
+        s_imageDescriptors[FONT_IMAGE_ID + static_cast<std::uint32_t>(script)], get_font_texture_handle(script));
+    if constexpr (fs::stats::is_enabled)
+        printf("Font textures: %zu KiB\n", imgui::deko3d::getFontTextureSize() / 1024);
+}
+
+// What the data tabs display, derived from the save, the language and the time of day
+// Computed when one of those changes rather than on every frame, drawing only reads them
+struct ViewKey {
+    std::uint32_t island, language, slot;
+
+    constexpr bool operator ==(const ViewKey &other) const = default;
+};
+
+struct TurnipView {
+    std::array<char, 0x100>                price_pattern;
+    std::array<const char *, 7>            day_names;
+    std::array<std::array<char, 0x10>, 14> prices;
+    std::array<const std::uint32_t *, 14>  colors;
+    std::array<float, 12>                  graph; // Monday to Saturday
+    std::array<char, 0x40>                 max, min, average;
+};
+
+struct VisitorView {
+    struct Row {
+        const char          *day, *visitor;
+        const char          *npc_1, *npc_2; // Celeste and Wisp, if they visit that day
+        const std::uint32_t *color;
+    };
+
+    std::array<Row, 7> rows; // Monday to Sunday
+};
+
+struct WeatherView {
+    std::array<char, 0x80> hemisphere, seed;
+};
+
+std::array<const char *, 7> get_day_names() {
+    return {
+        lang::get_string("days", "sunday"),
+        lang::get_string("days", "monday"),
+        lang::get_string("days", "tuesday"),
+        lang::get_string("days", "wednesday"),
+        lang::get_string("days", "thursday"),
+        lang::get_string("days", "friday"),
+        lang::get_string("days", "saturday"),
+    };
+}
+
+// `slot` is the current half-day, highlighted in the table
+const TurnipView &get_turnip_view(const tp::IslandSnapshot &island, std::uint32_t slot) {
+    static TurnipView view;
+    static std::optional<ViewKey> key;
+    if (auto k = ViewKey{island.get_generation(), lang::get_generation(), slot}; key == k)
+        return view;
+    else
+        key = k;
+
+    auto &prices = island.turnips().prices;
+
+    std::snprintf(view.price_pattern.data(), view.price_pattern.size(), "price_pattern"_lang,
+        prices.buy_price, island.turnips().get_pattern());
+    view.day_names = get_day_names();
+
+    auto minmax  = std::minmax_element(prices.week_prices.begin() + 2, prices.week_prices.end());
+    auto min = *minmax.first, max = *minmax.second;
+    float average = static_cast<float>(std::accumulate(prices.week_prices.begin() + 2,
+        prices.week_prices.end(), 0)) / (prices.week_prices.size() - 2);
+
+    for (std::size_t i = 0; i < prices.week_prices.size(); ++i) {
+        auto price = prices.week_prices[i];
+        std::snprintf(view.prices[i].data(), view.prices[i].size(), "%d", price);
+
+        if (i == slot)
+            view.colors[i] = &th::text_cur_col;
+        else if (price == max)
+            view.colors[i] = &th::text_max_col;
+        else if (price == min)
+            view.colors[i] = &th::text_min_col;
+        else
+            view.colors[i] = &th::text_def_col;
+
+        if (i >= 2)
+            view.graph[i - 2] = static_cast<float>(price);
+    }
+
+    std::snprintf(view.max.data(),     view.max.size(),     "turnips_max"_lang,     max);
+    std::snprintf(view.min.data(),     view.min.size(),     "turnips_min"_lang,     min);
+    std::snprintf(view.average.data(), view.average.size(), "turnips_average"_lang, average);
+
+    return view;
+}
+
+// `wday` is the current visitor day
+const VisitorView &get_visitor_view(const tp::IslandSnapshot &island, std::uint32_t wday) {
+    static VisitorView view;
+    static std::optional<ViewKey> key;
+    if (auto k = ViewKey{island.get_generation(), lang::get_generation(), wday}; key == k)
+        return view;
+    else
+        key = k;
+
+    auto &parser   = island.visitors();
+    auto day_names = get_day_names();
+    auto names     = parser.get_visitor_names();
+
+    for (std::uint32_t i = 0; i < view.rows.size(); ++i) {
+        auto day = (i + 1) % 7;
+        view.rows[i] = {
+            day_names[day], names[day],
+            (day == parser.get_celeste_day()) ? lang::get_string("npcs", "celeste") : nullptr,
+            (day == parser.get_wisp_day())    ? lang::get_string("npcs", "wisp")    : nullptr,
+            (day == wday) ? &th::text_cur_col : &th::text_def_col,
+        };
+    }
+
+    return view;
+}
+
+const WeatherView &get_weather_view(const tp::IslandSnapshot &island) {
+    static WeatherView view;
+    static std::optional<ViewKey> key;
+    if (auto k = ViewKey{island.get_generation(), lang::get_generation(), 0}; key == k)
+        return view;
+    else
+        key = k;
+
+    auto &parser = island.weather();
+    auto seed    = parser.calculate_weather_seed();
+    std::snprintf(view.hemisphere.data(), view.hemisphere.size(), "hemisphere"_lang, parser.get_hemisphere_name());
+    std::snprintf(view.seed.data(),       view.seed.size(),       "weather_seed"_lang, seed, seed);
+
+    return view;
+}
+
+void start_backup_job(BackupJob::Kind kind, const char *name, std::function<Result(BackupJob &)> &&fn) {
+    s_backupJob = std::make_unique<BackupJob>();
+    s_backupJob->kind = kind, s_backupJob->name = name;
+    s_backupJob->thread = std::thread([job = s_backupJob.get(), fn = std::move(fn)] {
+        job->rc   = fn(*job);
+        job->done = true;
+        ueventSignal(&s_wakeEvent);
+    });
+}
+
+// Sections that couldn't be found in a save from an unknown game version
+void draw_unknown_version() {
+    im::Dummy(ImVec2(0.0f, 10.0f));
+    do_with_color(th::text_min_col, [] { im::TextUnformatted("section_unknown_version"_lang); });
+}
+
+// ImGui allocates with malloc, count its allocations along with the C++ ones
+void *imgui_alloc(std::size_t size, void *) {
+    pf::count_allocation();
+    return std::malloc(size);
+}
+
+void imgui_free(void *ptr, void *) {
+    std::free(ptr);
+}
+
+// Drawn over every window, without taking part in focus or navigation
+void draw_profiler() {
+    constexpr float X = 20, Y = 20, NAME_WIDTH = 180, COL_WIDTH = 110, MARGIN = 10;
+
+    auto *list = ImGui::GetForegroundDrawList();
+    auto line_height = ImGui::GetTextLineHeightWithSpacing();
+    auto num_lines   = pf::phase_names.size() + 3;
+    list->AddRectFilled(ImVec2(X - MARGIN, Y - MARGIN),
+        ImVec2(X + NAME_WIDTH + 2 * COL_WIDTH + MARGIN, Y + num_lines * line_height + MARGIN), IM_COL32(0, 0, 0, 0xc0));
+
+    std::size_t line = 0;
+    auto add_line = [&](const char *name, const char *col1, const char *col2) {
+        auto y = Y + line++ * line_height;
+        list->AddText(ImVec2(X, y),                          IM_COL32_WHITE, name);
+        list->AddText(ImVec2(X + NAME_WIDTH, y),             IM_COL32_WHITE, col1);
+        list->AddText(ImVec2(X + NAME_WIDTH + COL_WIDTH, y), IM_COL32_WHITE, col2);
+    };
+
+    std::array<char, 0x20> col1, col2;
+    add_line("phase", "p50 ms", "p99 ms");
+    for (std::size_t i = 0; i < pf::phase_names.size(); ++i) {
+        auto stats = pf::get(static_cast<pf::Phase>(i));
+        std::snprintf(col1.data(), col1.size(), "%.2f", stats.p50_ms);
+        std::snprintf(col2.data(), col2.size(), "%.2f", stats.p99_ms);
+        add_line(pf::phase_names[i], col1.data(), col2.data());
+    }
+
+    if constexpr (pf::counts_allocations) {
+        auto allocs = pf::get_allocations();
+        std::snprintf(col1.data(), col1.size(), "%.1f", allocs.avg);
+        std::snprintf(col2.data(), col2.size(), "%u", allocs.p99);
+        add_line("allocs", col1.data(), col2.data());
+    }
+
+    std::snprintf(col1.data(), col1.size(), "%zu", pf::get_num_frames());
+    add_line("frames", col1.data(), "");
+}
+
 } // namespace
 
 bool init() {
+    ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
     ImGui::CreateContext();
     if (!imgui::nx::init())
         return false;
 
+    // Only the atlas of the requested language is built at startup, the others on first use
+    auto script = s_fontScript = get_font_script(lang::get_current_language());
+    tr::begin("font_atlas");
+    imgui::nx::setFontScript(script);
+    tr::end();
+
+    tr::begin("deko3d_init");
     deko3dInit();
     imgui::deko3d::init(s_device,
         s_queue,
         s_cmdBuf[0],
-        s_samplerDescriptors[0],
-        s_imageDescriptors[0],
-        dkMakeTextureHandle(0, 0),
+        s_samplerDescriptors[FONT_SAMPLER_ID],
+        s_imageDescriptors[FONT_IMAGE_ID + static_cast<std::uint32_t>(script)],
+        get_font_texture_handle(script),
         FB_NUM);
+    tr::end();
 
+    if constexpr (fs::stats::is_enabled)
+        printf("Font textures: %zu KiB\n", imgui::deko3d::getFontTextureSize() / 1024);
+
+    ueventCreate(&s_wakeEvent, true);
+
+    s_startNs = s_lastEventNs = armTicksToNs(armGetSystemTick()), s_startCpuNs = get_cpu_time_ns();
     return true;
 }
 
+void set_max_idle_interval(std::uint64_t ns) {
+    s_maxIdleNs = ns;
+}
+
 bool loop() {
-    if (!appletMainLoop())
-        return false;
+    // Nothing on screen changes without input, an applet event or a language switch, except for what depends
+    // on the time: wait for one of those, or for the max idle interval, before drawing the next frame
+    while (true) {
+        if (!appletMainLoop())
+            return false;
+
+        auto has_event = imgui::nx::pollEvents();
+
+        // Language changes take effect between frames, once the tables are loaded, along with the font atlas
+        if (lang::update())
+            set_font_script(get_font_script(lang::get_current_language())), has_event = true;
+
+        auto now = armTicksToNs(armGetSystemTick());
+        if (has_event)
+            s_lastEventNs = now;
+
+        // Profiling needs a steady stream of frames
+        if (!s_maxIdleNs || s_showProfiler || (now - s_lastEventNs < ACTIVE_NS) || (now - s_lastFrameNs >= s_maxIdleNs)) {
+            s_lastFrameNs = now, ++s_numFrames;
+            break;
+        }
+
+        // Applet messages and background jobs wake the loop right away, input is sampled on the next wake
+        // The timeout doesn't go past the next forced frame
+        auto timeout = std::min(POLL_NS, s_maxIdleNs - (now - s_lastFrameNs));
+        s32 idx;
+        auto rc = waitMulti(&idx, timeout, waiterForEvent(appletGetMessageEvent()), waiterForUEvent(&s_wakeEvent));
+
+        auto woken = armTicksToNs(armGetSystemTick());
+        if (R_SUCCEEDED(rc) && (idx == 1))
+            s_lastEventNs = woken;
+        s_idleNs += woken - now, ++s_numWakes;
+    }
+
+    pf::begin_frame();
+
+    auto down = [] {
+        auto timer = pf::Timer(pf::Phase::NewFrame);
+        auto buttons = imgui::nx::newFrame();
+        ImGui::NewFrame();
+        return buttons;
+    }();
 
-    auto down = imgui::nx::newFrame();
-    ImGui::NewFrame();
+    if (down & HidNpadButton_Minus)
+        s_showProfiler = !s_showProfiler;
 
     // Add background image
     ImGui::GetBackgroundDrawList()->AddImage(
@@ -231,7 +581,13 @@ bool loop() {
 }
 
 void render() {
-    ImGui::Render();
+    if (s_showProfiler)
+        draw_profiler();
+
+    {
+        auto timer = pf::Timer(pf::Phase::ImGuiRender);
+        ImGui::Render();
+    }
 
     auto &io = ImGui::GetIO();
 
@@ -256,17 +612,33 @@ void render() {
     cmdBuf.clearDepthStencil(true, 1.0f, 0xFF, 0);
     s_queue.submitCommands(cmdBuf.finishList());
 
-    imgui::deko3d::render(s_device, s_queue, cmdBuf, slot);
+    {
+        auto timer = pf::Timer(pf::Phase::Draw);
+        imgui::deko3d::render(s_device, s_queue, cmdBuf, slot);
+    }
 
     // wait for fragments to be completed before discarding depth/stencil buffer
     cmdBuf.barrier(DkBarrier_Fragments, 0);
     cmdBuf.discardDepthStencil();
 
     // present image
-    s_queue.presentImage(s_swapchain, slot);
+    {
+        auto timer = pf::Timer(pf::Phase::Present);
+        s_queue.presentImage(s_swapchain, slot);
+    }
+
+    pf::end_frame();
 }
 
 void exit() {
+    // An interrupted restore would leave the save half-written
+    if (s_backupJob)
+        s_backupJob->thread.join();
+
+    auto runtime = armTicksToNs(armGetSystemTick()) - s_startNs, cpu_time = get_cpu_time_ns() - s_startCpuNs;
+    printf("Drew %u frames and woke %u times in %.1fs, idle %.1f%% of the time, main thread CPU %.1f%%\n",
+        s_numFrames, s_numWakes, runtime / 1e9, 100.0 * s_idleNs / runtime, 100.0 * cpu_time / runtime);
+
     imgui::nx::exit();
 
     // wait for queue to be idle
@@ -276,7 +648,15 @@ void exit() {
     deko3dExit();
 }
 
+const char *make_label(const char *text, const char *id) {
+    static std::array<char, 0x100> label;
+    std::snprintf(label.data(), label.size(), "%s###%s", text, id);
+    return label.data();
+}
+
 bool create_background(const std::string &path) {
+    auto trace = tr::Span("background_decode");
+
     nj::Decoder decoder;
     if (auto rc = decoder.initialize(); rc) {
         printf("Failed to initialize decoder: %#x\n", rc);
@@ -316,166 +696,125 @@ bool create_background(const std::string &path) {
     return true;
 }
 
-void draw_turnip_tab(const tp::TurnipParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
-    if (!im::BeginTabItem(("turnips"_lang + "###turnips").c_str()))
+void draw_turnip_tab(const tp::IslandSnapshot &island, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
+    if (!im::BeginTabItem(make_label("turnips"_lang, "turnips")))
         return;
 
-    auto prices  = parser.prices;
-    auto pattern = parser.get_pattern();
-
-    auto days_json = lang::get_json()["days"];
-    std::array day_names = {
-        lang::get_string("sunday",    days_json),
-        lang::get_string("monday",    days_json),
-        lang::get_string("tuesday",   days_json),
-        lang::get_string("wednesday", days_json),
-        lang::get_string("thursday",  days_json),
-        lang::get_string("friday",    days_json),
-        lang::get_string("saturday",  days_json),
-    };
+    if (!island.turnips().located) {
+        draw_unknown_version();
+        im::EndTabItem();
+        return;
+    }
 
-    std::array<float, 14> float_prices;
-    for (std::size_t i = 0; i < prices.week_prices.size(); ++i)
-        float_prices[i] = static_cast<float>(prices.week_prices[i]);
-    auto  minmax  = std::minmax_element(prices.week_prices.begin() + 2, prices.week_prices.end());
-    auto  min = *minmax.first, max = *minmax.second;
-    float average = static_cast<float>(std::accumulate(prices.week_prices.begin() + 2,
-        prices.week_prices.end(), 0)) / (prices.week_prices.size() - 2);
+    auto &view = get_turnip_view(island, 2 * cal_info.wday + (cal_time.hour >= 12));
 
-    im::Text("price_pattern"_lang.c_str(), prices.buy_price, pattern.c_str());
+    im::TextUnformatted(view.price_pattern.data());
 
     im::BeginTable("##Prices table", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
     im::TableSetupColumn("");
-    im::TableSetupColumn("am"_lang.c_str());
-    im::TableSetupColumn("pm"_lang.c_str());
+    im::TableSetupColumn("am"_lang);
+    im::TableSetupColumn("pm"_lang);
     ImGui::TableHeadersRow();
 
-    auto get_color = [&](std::uint32_t day, bool is_am) -> std::uint32_t {
-        auto price = prices.week_prices[2 * day + !is_am];
-        if ((cal_info.wday == day) && ((is_am && (cal_time.hour < 12)) || (!is_am && (cal_time.hour >= 12))))
-            return th::text_cur_col;
-        else if (price == max)
-            return th::text_max_col;
-        else if (price == min)
-            return th::text_min_col;
-        return th::text_def_col;
-    };
-
-    auto print_day = [&](std::uint32_t day) -> void {
-        im::TableNextRow(), im::TableNextColumn(), im::TextUnformatted(day_names[day].c_str());
-        do_with_color(get_color(day, true),  [&] { im::TableNextColumn(), im::Text("%d", prices.week_prices[2 * day]); });
-        do_with_color(get_color(day, false), [&] { im::TableNextColumn(), im::Text("%d", prices.week_prices[2 * day + 1]); });
-    };
-
-    print_day(0);
-    print_day(1); print_day(2); print_day(3);
-    print_day(4); print_day(5); print_day(6);
+    for (std::size_t day = 0; day < view.day_names.size(); ++day) {
+        im::TableNextRow(), im::TableNextColumn(), im::TextUnformatted(view.day_names[day]);
+        for (auto i: {2 * day, 2 * day + 1})
+            do_with_color(*view.colors[i], [&] { im::TableNextColumn(), im::TextUnformatted(view.prices[i].data()); });
+    }
     im::EndTable();
 
     im::Separator();
-    do_with_color(th::text_max_col, [&] { im::Text("turnips_max"_lang.c_str(), max); }); im::SameLine();
-    do_with_color(th::text_min_col, [&] { im::Text("turnips_min"_lang.c_str(), min); }); im::SameLine();
-    im::Text("turnips_average"_lang.c_str(), average);
+    do_with_color(th::text_max_col, [&] { im::TextUnformatted(view.max.data()); }); im::SameLine();
+    do_with_color(th::text_min_col, [&] { im::TextUnformatted(view.min.data()); }); im::SameLine();
+    im::TextUnformatted(view.average.data());
 
     im::Separator();
-    im::TextUnformatted("week_graph"_lang.c_str());
-    im::PlotLines("##Graph", float_prices.data() + 2, float_prices.size() - 2,
+    im::TextUnformatted("week_graph"_lang);
+    im::PlotLines("##Graph", view.graph.data(), view.graph.size(),
         0, "", FLT_MAX, FLT_MAX, {im::GetWindowWidth() - 30.0f, 125.0f});
 
     im::EndTabItem();
 }
 
-void draw_visitor_tab(const tp::VisitorParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
-    if (!im::BeginTabItem(("visitors"_lang + "###visitors").c_str()))
+void draw_visitor_tab(const tp::IslandSnapshot &island, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info) {
+    if (!im::BeginTabItem(make_label("visitors"_lang, "visitors")))
+        return;
+
+    if (!island.visitors().located) {
+        draw_unknown_version();
+        im::EndTabItem();
         return;
+    }
 
     // Visitors leave at 5am, so adjust the weekday
     auto wday = (cal_time.hour >= 5) ? cal_info.wday : std::clamp(cal_info.wday - 1, 0u, 7u);
-
-    auto days_json = lang::get_json()["days"];
-    std::array day_names = {
-        lang::get_string("sunday",    days_json),
-        lang::get_string("monday",    days_json),
-        lang::get_string("tuesday",   days_json),
-        lang::get_string("wednesday", days_json),
-        lang::get_string("thursday",  days_json),
-        lang::get_string("friday",    days_json),
-        lang::get_string("saturday",  days_json),
-    };
-
-    auto names = parser.get_visitor_names();
+    auto &view = get_visitor_view(island, wday);
 
     im::Dummy(ImVec2(0.0f, 10.0f));
     im::BeginTable("##Visitors table", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersH | ImGuiTableFlags_BordersV);
 
-    auto get_color = [&](std::uint32_t day) -> std::uint32_t {
-        return (wday == day) ? th::text_cur_col : th::text_def_col;
-    };
-
-    auto print_day = [&](std::uint32_t day) -> void {
-        im::TableNextColumn(); im::TextUnformatted(day_names[day].c_str());
-        do_with_color(get_color(day), [&] {
-            im::TableNextColumn(), im::Text("%s", names[day].c_str());
-            if (day == parser.get_celeste_day())
-                im::SameLine(), im::TextUnformatted(lang::get_string("celeste", lang::get_json()["npcs"]).c_str());
-            if (day == parser.get_wisp_day())
-                im::SameLine(), im::TextUnformatted(lang::get_string("wisp",    lang::get_json()["npcs"]).c_str());
+    for (auto &row: view.rows) {
+        im::TableNextColumn(); im::TextUnformatted(row.day);
+        do_with_color(*row.color, [&] {
+            im::TableNextColumn(), im::TextUnformatted(row.visitor);
+            if (row.npc_1)
+                im::SameLine(), im::TextUnformatted(row.npc_1);
+            if (row.npc_2)
+                im::SameLine(), im::TextUnformatted(row.npc_2);
         });
-    };
-
-    print_day(1); print_day(2); print_day(3);
-    print_day(4); print_day(5); print_day(6);
-    print_day(0);
+    }
     im::EndTable();
 
     im::EndTabItem();
 }
 
-void draw_weather_tab(const tp::WeatherSeedParser &parser) {
-    if (!im::BeginTabItem(("weather"_lang + "###weather").c_str()))
+void draw_weather_tab(const tp::IslandSnapshot &island) {
+    if (!im::BeginTabItem(make_label("weather"_lang, "weather")))
+        return;
+
+    if (!island.weather().located) {
+        draw_unknown_version();
+        im::EndTabItem();
         return;
+    }
 
-    auto seed = parser.calculate_weather_seed();
+    auto &view = get_weather_view(island);
 
     im::Dummy(ImVec2(0.0f, 10.0f));
-    im::Text("hemisphere"_lang.c_str(), parser.get_hemisphere_name().c_str());
-    im::Text("weather_seed"_lang.c_str(), seed, seed);
+    im::TextUnformatted(view.hemisphere.data());
+    im::TextUnformatted(view.seed.data());
 
     im::Separator();
-    im::TextUnformatted("weather_url_tip"_lang.c_str());
+    im::TextUnformatted("weather_url_tip"_lang);
 
     im::EndTabItem();
 }
 
 void draw_language_tab() {
-    if (!im::BeginTabItem(("language"_lang + "###lang").c_str()))
+    if (!im::BeginTabItem(make_label("language"_lang, "lang")))
         return;
 
     if (im::BeginTable("##langtbl", 2)) {
         auto cur_lang = lang::get_current_language(), prev_lang = cur_lang;
 
-        im::TableNextColumn();
-        im::RadioButton("English",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::English));
-        im::RadioButton("Nederlands", reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Dutch));
-        im::RadioButton("Français",   reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::French));
-        im::RadioButton("Italiano",   reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Italian));
-        im::RadioButton("Deutsch",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::German));
-        im::RadioButton("Español",    reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Spanish));
-        im::RadioButton("Português",  reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Portuguese));
-        im::RadioButton("Polski",     reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Polish));
-        im::RadioButton("Latina",     reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Latin));
-
-        im::TableNextColumn();
-        im::RadioButton("简体中文",     reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::ChineseSimplified));
-        im::RadioButton("繁體中文",     reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::ChineseTraditional));
-        im::RadioButton("日本語",       reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Japanese));
-        im::RadioButton("琉球諸語",     reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::JapaneseRyukyuan));
-        im::RadioButton("한국어",       reinterpret_cast<int *>(&cur_lang), static_cast<int>(lang::Language::Korean));
+        // Latin languages in the first column. A name is only in the atlas of its script, others get their ASCII name
+        for (auto is_latin: {true, false}) {
+            im::TableNextColumn();
+            for (auto &name: lang::language_names) {
+                auto script = get_font_script(name.language);
+                if ((script == imgui::nx::FontScript::Latin) != is_latin)
+                    continue;
+                im::RadioButton((script == s_fontScript) ? name.name : name.ascii_name,
+                    reinterpret_cast<int *>(&cur_lang), static_cast<int>(name.language));
+            }
+        }
 
         im::EndTable();
 
-        if (cur_lang != prev_lang)
-            lang::set_language(cur_lang);
+        if (cur_lang != prev_lang) {
+            if (auto rc = lang::set_language(cur_lang); R_FAILED(rc))
+                printf("Failed to set language %d: %#x\n", static_cast<int>(cur_lang), rc);
+        }
     }
 
     im::Separator();
@@ -484,4 +823,100 @@ void draw_language_tab() {
     im::EndTabItem();
 }
 
+bool draw_backup_tab(bk::BackupStore &store, fs::Filesystem &save, const TimeCalendarTime &cal_time) {
+    // Jobs finish even when the tab isn't shown
+    bool is_restored = false;
+    if (s_backupJob && s_backupJob->done) {
+        auto &job = *s_backupJob;
+        job.thread.join();
+
+        if (job.kind == BackupJob::Kind::Create) {
+            if (R_SUCCEEDED(job.rc))
+                std::snprintf(s_backupStatus.data(), s_backupStatus.size(), "backup_done"_lang, job.stats.num_files,
+                    job.stats.total_size / 1024, job.stats.new_size / 1024, job.stats.stored_size / 1024);
+            else
+                std::snprintf(s_backupStatus.data(), s_backupStatus.size(), "backup_failed"_lang, job.rc);
+        } else {
+            if (R_SUCCEEDED(job.rc))
+                std::snprintf(s_backupStatus.data(), s_backupStatus.size(), "backup_restored"_lang, job.name.c_str());
+            else
+                std::snprintf(s_backupStatus.data(), s_backupStatus.size(), "backup_restore_failed"_lang, job.rc);
+            is_restored = R_SUCCEEDED(job.rc);
+        }
+
+        s_backupJob.reset();
+        s_needsSnapshotRefresh = true;
+    }
+
+    if (!im::BeginTabItem(make_label("backups"_lang, "backups")))
+        return is_restored;
+
+    static std::vector<std::string> snapshots;
+    static int selected = -1;
+
+    if (s_needsSnapshotRefresh)
+        snapshots = store.list_snapshots(), selected = -1, s_needsSnapshotRefresh = false;
+
+    bool is_busy       = !!s_backupJob;
+    bool has_selection = (selected >= 0) && (selected < static_cast<int>(snapshots.size()));
+
+    im::Dummy(ImVec2(0.0f, 10.0f));
+    if (is_busy)
+        im::PushStyleVar(ImGuiStyleVar_Alpha, 0.5f);
+    if (im::Button("backup_create"_lang) && !is_busy) {
+        char name[0x20];
+        std::snprintf(name, sizeof(name), "%04d-%02d-%02d_%02d-%02d-%02d",
+            cal_time.year, cal_time.month, cal_time.day, cal_time.hour, cal_time.minute, cal_time.second);
+        start_backup_job(BackupJob::Kind::Create, name, [&store, &save](BackupJob &job) {
+            return store.create_snapshot(save, job.name, job.stats);
+        });
+    }
+    if (is_busy)
+        im::PopStyleVar();
+
+    im::SameLine();
+    if (is_busy || !has_selection)
+        im::PushStyleVar(ImGuiStyleVar_Alpha, 0.5f);
+    if (im::Button("backup_restore"_lang) && !is_busy && has_selection)
+        im::OpenPopup("###restore");
+    if (is_busy || !has_selection)
+        im::PopStyleVar();
+
+    if (is_busy)
+        im::TextUnformatted("backup_working"_lang);
+    else if (s_backupStatus[0])
+        im::TextUnformatted(s_backupStatus.data());
+
+    im::Separator();
+    if (snapshots.empty())
+        do_with_color(th::text_min_col, [] { im::TextUnformatted("backup_none"_lang); });
+
+    im::BeginChild("##snapshots");
+    for (int i = 0; i < static_cast<int>(snapshots.size()); ++i)
+        if (im::Selectable(snapshots[i].c_str(), i == selected))
+            selected = i;
+    im::EndChild();
+
+    if (im::BeginPopupModal(make_label("backup_restore"_lang, "restore"), nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
+        auto *name = has_selection ? snapshots[selected].c_str() : "";
+        im::Text("backup_restore_confirm"_lang, name);
+
+        if (im::Button("yes"_lang)) {
+            if (!is_busy && has_selection)
+                start_backup_job(BackupJob::Kind::Restore, name, [&store, &save](BackupJob &job) {
+                    return store.restore_snapshot(job.name, save);
+                });
+            im::CloseCurrentPopup();
+        }
+        im::SameLine();
+        if (im::Button("no"_lang) || !has_selection)
+            im::CloseCurrentPopup();
+
+        im::EndPopup();
+    }
+
+    im::EndTabItem();
+    return is_restored;
+}
+
 } // namespace gui
@@ -23,7 +23,9 @@
 #include <imgui.h>
 #include <switch.h>
 
-#include "parser.hpp"
+#include "fs.hpp"
+#include "backup.hpp"
+#include "island.hpp"
 
 namespace im {
     using namespace ImGui;
@@ -31,17 +33,29 @@ namespace im {
 
 namespace gui {
 
+// Time-dependent contents are refreshed at least this often while idle
+constexpr std::uint64_t DEFAULT_MAX_IDLE_NS = 1'000'000'000;
+
 bool init();
 bool loop();
 void render();
 void exit();
 
+// While there is no input nor other event, loop waits for up to `ns` before returning, 0 draws every frame
+void set_max_idle_interval(std::uint64_t ns);
+
 bool create_background(const std::string &path);
 
-void draw_turnip_tab(const tp::TurnipParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
-void draw_visitor_tab(const tp::VisitorParser &parser, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
-void draw_weather_tab(const tp::WeatherSeedParser &parser);
+// "text###id", so that the widget keeps its state when the language changes
+// The label is formatted in a shared buffer, valid until the next call
+const char *make_label(const char *text, const char *id);
+
+void draw_turnip_tab(const tp::IslandSnapshot &island, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
+void draw_visitor_tab(const tp::IslandSnapshot &island, const TimeCalendarTime &cal_time, const TimeCalendarAdditionalInfo &cal_info);
+void draw_weather_tab(const tp::IslandSnapshot &island);
 void draw_language_tab();
+// Returns true once a backup was restored over the save, which then needs to be reloaded
+bool draw_backup_tab(bk::BackupStore &store, fs::Filesystem &save, const TimeCalendarTime &cal_time);
 
 template <typename F>
 void do_with_color(std::uint32_t col, F f) {
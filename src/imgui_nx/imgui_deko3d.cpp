@@ -26,6 +26,7 @@
 // SOFTWARE.
 
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
 #include <cstdio>
@@ -95,10 +96,18 @@ std::vector<dk::UniqueMemBlock> s_vtxMemBlock;
 /// \brief Index data memblock
 std::vector<dk::UniqueMemBlock> s_idxMemBlock;
 
-/// \brief Font image memblock
-dk::UniqueMemBlock s_fontImageMemBlock;
-/// \brief Font texture handle
-DkResHandle s_fontTextureHandle;
+/// \brief Font image memblocks, one per atlas
+std::vector<dk::UniqueMemBlock> s_fontImageMemBlock;
+/// \brief Font texture handles, one per atlas
+std::vector<DkResHandle> s_fontTextureHandle;
+
+/// \brief Whether a texture is a font atlas
+/// \param handle_ Texture handle
+bool isFontTexture (DkResHandle handle_)
+{
+	return std::find (s_fontTextureHandle.begin (), s_fontTextureHandle.end (), handle_) !=
+	       s_fontTextureHandle.end ();
+}
 
 /// \brief Load shader code
 void loadShaders (dk::UniqueDevice &device_)
@@ -281,9 +290,27 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 		        .create ());
 	}
 
+	// initialize sampler descriptor
+	samplerDescriptor_.initialize (
+	    dk::Sampler{}
+	        .setFilter (DkFilter_Linear, DkFilter_Linear)
+	        .setWrapMode (DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
+
+	// upload texture atlas
+	addFontTexture (device_, queue_, cmdBuf_, imageDescriptor_, fontTextureHandle_);
+}
+
+void imgui::deko3d::addFontTexture (dk::UniqueDevice &device_,
+    dk::UniqueQueue &queue_,
+    dk::UniqueCmdBuf &cmdBuf_,
+    dk::ImageDescriptor &imageDescriptor_,
+    DkResHandle fontTextureHandle_)
+{
+	auto &io = ImGui::GetIO ();
+
 	// get texture atlas
 	io.Fonts->SetTexID (makeTextureID (fontTextureHandle_));
-	s_fontTextureHandle = fontTextureHandle_;
+	s_fontTextureHandle.emplace_back (fontTextureHandle_);
 	unsigned char *pixels;
 	int width;
 	int height;
@@ -296,12 +323,6 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 	        .create ();
 	std::memcpy (memBlock.getCpuAddr (), pixels, width * height);
 
-	// initialize sampler descriptor
-	samplerDescriptor_.initialize (
-	    dk::Sampler{}
-	        .setFilter (DkFilter_Linear, DkFilter_Linear)
-	        .setWrapMode (DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge, DkWrapMode_ClampToEdge));
-
 	// initialize texture atlas image layout
 	dk::ImageLayout layout;
 	dk::ImageLayoutMaker{device_}
@@ -314,16 +335,19 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 	auto const fontSize  = layout.getSize ();
 
 	// create image memblock
-	s_fontImageMemBlock = dk::MemBlockMaker{device_,
+	auto &fontImageMemBlock = s_fontImageMemBlock.emplace_back (dk::MemBlockMaker{device_,
 	    align (fontSize, std::max<unsigned> (fontAlign, DK_MEMBLOCK_ALIGNMENT))}
 	                          .setFlags (DkMemBlockFlags_GpuCached | DkMemBlockFlags_Image)
-	                          .create ();
+	                          .create ());
 
 	// initialize font texture atlas image descriptor
 	dk::Image fontTexture;
-	fontTexture.initialize (layout, s_fontImageMemBlock, 0);
+	fontTexture.initialize (layout, fontImageMemBlock, 0);
 	imageDescriptor_.initialize (fontTexture);
 
+	// the descriptor may be added after the first frame
+	cmdBuf_.barrier (DkBarrier_None, DkInvalidateFlags_Descriptors);
+
 	// copy font texture atlas to image view
 	dk::ImageView imageView{fontTexture};
 	cmdBuf_.copyBufferToImage ({memBlock.getGpuAddr ()}, imageView,
@@ -336,9 +360,16 @@ void imgui::deko3d::init (dk::UniqueDevice &device_,
 	queue_.waitIdle ();
 }
 
+std::size_t imgui::deko3d::getFontTextureSize ()
+{
+	return std::accumulate (s_fontImageMemBlock.begin (), s_fontImageMemBlock.end (), std::size_t (0),
+	    [] (std::size_t size_, dk::UniqueMemBlock const &memBlock_) { return size_ + memBlock_.getSize (); });
+}
+
 void imgui::deko3d::exit ()
 {
-	s_fontImageMemBlock = nullptr;
+	s_fontImageMemBlock.clear ();
+	s_fontTextureHandle.clear ();
 
 	s_idxMemBlock.clear ();
 	s_vtxMemBlock.clear ();
@@ -497,11 +528,10 @@ void imgui::deko3d::render (dk::UniqueDevice &device_,
 				if (!boundTextureHandle || textureHandle != *boundTextureHandle)
 				{
 					// check if this is the first draw or changing to or from the font texture
-					if (!boundTextureHandle || textureHandle == s_fontTextureHandle ||
-					    *boundTextureHandle == s_fontTextureHandle)
+					if (!boundTextureHandle || isFontTexture (textureHandle) != isFontTexture (*boundTextureHandle))
 					{
 						FragUBO fragUBO;
-						fragUBO.font = (textureHandle == s_fontTextureHandle);
+						fragUBO.font = isFontTexture (textureHandle);
 
 						// update fragment shader UBO
 						cmdBuf_.pushConstants (
@@ -30,6 +30,7 @@
 #ifndef CLASSIC
 #include <deko3d.hpp>
 
+#include <cstddef>
 #include <cstdint>
 
 namespace imgui
@@ -52,6 +53,21 @@ void init (dk::UniqueDevice &device_,
     DkResHandle fontTextureHandle_,
     unsigned imageCount_);
 
+/// \brief Upload the current font atlas to a new texture, in addition to the ones already uploaded
+/// \param device_ deko3d device (used to allocate the font texture buffer)
+/// \param queue_ deko3d queue (used to run command lists)
+/// \param cmdBuf_ Command buffer (used to build command lists)
+/// \param[out] imageDescriptor_ Image descriptor for the font texture
+/// \param fontTextureHandle_ Texture handle that references the font sampler descriptor and imageDescriptor_
+void addFontTexture (dk::UniqueDevice &device_,
+    dk::UniqueQueue &queue_,
+    dk::UniqueCmdBuf &cmdBuf_,
+    dk::ImageDescriptor &imageDescriptor_,
+    DkResHandle fontTextureHandle_);
+
+/// \brief Get the GPU memory used by the font textures
+std::size_t getFontTextureSize ();
+
 /// \brief Deinitialize deko3d
 void exit ();
 
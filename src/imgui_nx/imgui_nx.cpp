@@ -28,10 +28,18 @@
 #include "imgui_nx.h"
 #include <imgui.h>
 
+#include "../crypto.hpp"
+#include "../font_cache.hpp"
+
+// Generated by the build from the language files (misc/extract_font_ranges.py)
+#include "font_ranges.h"
+
+#include <cstdio>
 #include <cstring>
 #include <array>
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <string>
 #include <utility>
 #include <switch.h>
@@ -51,53 +59,99 @@ AppletHookCookie s_appletHookCookie;
 
 PadState s_pad;
 
-ImWchar const nxFontRanges[] = {
-    // Autogenerated, do not edit
-    0x000a, 0x000a, 0x0020, 0x0021, 0x0023, 0x0023, 0x0025, 0x0029, 0x002c, 0x0032, 0x0034, 0x0034, 0x003a, 0x003a, 0x0041, 0x0057,
-    0x005a, 0x005a, 0x0061, 0x007a, 0x00a0, 0x00a1, 0x00c9, 0x00c9, 0x00df, 0x00e1, 0x00e3, 0x00e4, 0x00e7, 0x00ea, 0x00ec, 0x00ec,
-    0x00f1, 0x00f1, 0x00f3, 0x00f3, 0x00f6, 0x00f6, 0x00fa, 0x00fa, 0x00fc, 0x00fc, 0x0105, 0x0105, 0x0107, 0x0107, 0x0119, 0x0119,
-    0x0142, 0x0142, 0x015a, 0x015b, 0x017c, 0x017c, 0x3001, 0x3001, 0x3043, 0x3047, 0x304b, 0x304b, 0x304d, 0x304f, 0x3053, 0x3053,
-    0x3055, 0x3055, 0x3057, 0x3057, 0x3059, 0x3059, 0x3061, 0x3061, 0x3066, 0x3066, 0x3068, 0x3068, 0x306a, 0x306c, 0x306e, 0x306e,
-    0x3073, 0x3073, 0x3075, 0x3075, 0x307e, 0x307e, 0x3082, 0x3082, 0x3084, 0x3084, 0x308b, 0x308b, 0x308f, 0x308f, 0x3092, 0x3093,
-    0x30a1, 0x30a1, 0x30a3, 0x30a4, 0x30a6, 0x30a7, 0x30ab, 0x30ad, 0x30af, 0x30b0, 0x30b5, 0x30b9, 0x30bb, 0x30bb, 0x30bf, 0x30bf,
-    0x30c3, 0x30c3, 0x30c6, 0x30c6, 0x30c9, 0x30c9, 0x30cf, 0x30d1, 0x30d5, 0x30d7, 0x30d9, 0x30d9, 0x30e1, 0x30e1, 0x30e7, 0x30e7,
-    0x30e9, 0x30ec, 0x30f3, 0x30f4, 0x30fc, 0x30fc, 0x4e00, 0x4e00, 0x4e09, 0x4e0b, 0x4e0d, 0x4e0d, 0x4e2a, 0x4e2a, 0x4e2d, 0x4e2d,
-    0x4e70, 0x4e70, 0x4e88, 0x4e88, 0x4e8c, 0x4e8c, 0x4e94, 0x4e94, 0x4ee5, 0x4ee5, 0x4ef7, 0x4ef7, 0x4efb, 0x4efb, 0x4f53, 0x4f53,
-    0x4f55, 0x4f55, 0x4f5b, 0x4f5b, 0x4fa1, 0x4fa1, 0x4fdd, 0x4fde, 0x503c, 0x503c, 0x5085, 0x5085, 0x50f9, 0x50f9, 0x513f, 0x513f,
-    0x514b, 0x514b, 0x5165, 0x5165, 0x516d, 0x516d, 0x5206, 0x5206, 0x5217, 0x5217, 0x5229, 0x5229, 0x523b, 0x523b, 0x524d, 0x524d,
-    0x529b, 0x529b, 0x52a8, 0x52a8, 0x52bf, 0x52bf, 0x52d5, 0x52d5, 0x5317, 0x5317, 0x5348, 0x5348, 0x534a, 0x534a, 0x5357, 0x5357,
-    0x535c, 0x535c, 0x53e4, 0x53e4, 0x53ef, 0x53ef, 0x53f7, 0x53f8, 0x5415, 0x5415, 0x5468, 0x5468, 0x548c, 0x548c, 0x54c8, 0x54c8,
-    0x554f, 0x554f, 0x56db, 0x56db, 0x56fe, 0x56fe, 0x5716, 0x5716, 0x571f, 0x571f, 0x5728, 0x5728, 0x5747, 0x5747, 0x5904, 0x5904,
-    0x5909, 0x5909, 0x5927, 0x5927, 0x5929, 0x5929, 0x592b, 0x592b, 0x5b50, 0x5b50, 0x5b58, 0x5b58, 0x5ba2, 0x5ba2, 0x5c0f, 0x5c0f,
-    0x5c11, 0x5c11, 0x5c9a, 0x5c9a, 0x5cf0, 0x5cf0, 0x5df2, 0x5df2, 0x5e03, 0x5e03, 0x5e73, 0x5e73, 0x5e7d, 0x5e7d, 0x5ef7, 0x5ef7,
-    0x5f0f, 0x5f0f, 0x5f48, 0x5f48, 0x5f8c, 0x5f8c, 0x5fb7, 0x5fb7, 0x6240, 0x6240, 0x62c9, 0x62c9, 0x6492, 0x6492, 0x654f, 0x654f,
-    0x6587, 0x6587, 0x65af, 0x65af, 0x65b9, 0x65b9, 0x65e5, 0x65e5, 0x65f6, 0x65f6, 0x661f, 0x661f, 0x662f, 0x662f, 0x6642, 0x6642,
-    0x66dc, 0x66dc, 0x6700, 0x6700, 0x6708, 0x6709, 0x671f, 0x671f, 0x6728, 0x6728, 0x672c, 0x672c, 0x6765, 0x6765, 0x683c, 0x683c,
-    0x6863, 0x6863, 0x6885, 0x6885, 0x6a19, 0x6a19, 0x6a21, 0x6a21, 0x6b21, 0x6b21, 0x6b64, 0x6b64, 0x6beb, 0x6beb, 0x6c14, 0x6c14,
-    0x6c17, 0x6c17, 0x6c23, 0x6c23, 0x6c34, 0x6c34, 0x6c92, 0x6c92, 0x6ce2, 0x6ce2, 0x6d41, 0x6d41, 0x6d4b, 0x6d4b, 0x6d77, 0x6d77,
-    0x6e1b, 0x6e1b, 0x6e2c, 0x6e2c, 0x6e38, 0x6e38, 0x706b, 0x706b, 0x7136, 0x7136, 0x723e, 0x723e, 0x7248, 0x7248, 0x72d0, 0x72d0,
-    0x73a9, 0x73a9, 0x73c2, 0x73c2, 0x7403, 0x7403, 0x7409, 0x7409, 0x74e6, 0x74e6, 0x7684, 0x7684, 0x76d7, 0x76d7, 0x79cd, 0x79cd,
-    0x7a2e, 0x7a2e, 0x7a57, 0x7a57, 0x7ad9, 0x7ad9, 0x7b80, 0x7b80, 0x7c64, 0x7c64, 0x7cbe, 0x7cbe, 0x7d42, 0x7d42, 0x7e41, 0x7e41,
-    0x7ee2, 0x7ee2, 0x7ef5, 0x7ef5, 0x7f51, 0x7f51, 0x7fa4, 0x7fa4, 0x8005, 0x8005, 0x840a, 0x840a, 0x841d, 0x841d, 0x8514, 0x8514,
-    0x851a, 0x851a, 0x859b, 0x859b, 0x863f, 0x863f, 0x8868, 0x8868, 0x8a00, 0x8a00, 0x8a2a, 0x8a2a, 0x8a9e, 0x8a9e, 0x8af8, 0x8af8,
-    0x8bbf, 0x8bbf, 0x8bed, 0x8bed, 0x8cb7, 0x8cb7, 0x8cfc, 0x8cfc, 0x8d2c, 0x8d2c, 0x8d8b, 0x8d8b, 0x8e22, 0x8e22, 0x8f15, 0x8f15,
-    0x8f38, 0x8f38, 0x8f93, 0x8f93, 0x8fc7, 0x8fc7, 0x8fd9, 0x8fd9, 0x9031, 0x9031, 0x904e, 0x904e, 0x905e, 0x905e, 0x91d1, 0x91d1,
-    0x9593, 0x9593, 0x95f4, 0x95f4, 0x96e8, 0x96e8, 0x96f7, 0x96f7, 0x9748, 0x9748, 0x9769, 0x9769, 0x9810, 0x9810, 0x9884, 0x9884,
-    0x9a86, 0x9a86, 0x9ad4, 0x9ad4, 0x9ad8, 0x9ad8, 0x9f99, 0x9f99, 0xac00, 0xac00, 0xac04, 0xac04, 0xac10, 0xac10, 0xac1d, 0xac1d,
-    0xaca9, 0xaca9, 0xace0, 0xace0, 0xad6c, 0xad6d, 0xade0, 0xade0, 0xae08, 0xae08, 0xae68, 0xae68, 0xb0a0, 0xb0a0, 0xb0a8, 0xb0a8,
-    0xb298, 0xb298, 0xb2c8, 0xb2c8, 0xb300, 0xb300, 0xb3d9, 0xb3d9, 0xb41c, 0xb41c, 0xb77c, 0xb77c, 0xb798, 0xb798, 0xb808, 0xb808,
-    0xb825, 0xb825, 0xb97c, 0xb97c, 0xb9ad, 0xb9ad, 0xb9c8, 0xb9c9, 0xb9e4, 0xb9e4, 0xbaa9, 0xbaa9, 0xbb34, 0xbb34, 0xbb38, 0xbb38,
-    0xbc0f, 0xbc0f, 0xbc18, 0xbc18, 0xbc29, 0xbc29, 0xbc84, 0xbc84, 0xbcc0, 0xbcc0, 0xbd09, 0xbd09, 0xbd80, 0xbd81, 0xbe48, 0xbe48,
-    0xc0ac, 0xc0ac, 0xc11c, 0xc11c, 0xc131, 0xc131, 0xc138, 0xc138, 0xc18c, 0xc18c, 0xc218, 0xc219, 0xc21c, 0xc21c, 0xc2a4, 0xc2a4,
-    0xc2dc, 0xc2dc, 0xc528, 0xc528, 0xc557, 0xc557, 0xc5b4, 0xc5b4, 0xc5b8, 0xc5b8, 0xc5c6, 0xc5c6, 0xc5d0, 0xc5d0, 0xc5ec, 0xc5ec,
-    0xc624, 0xc625, 0xc628, 0xc628, 0xc694, 0xc694, 0xc6b0, 0xc6b1, 0xc6d4, 0xc6d4, 0xc720, 0xc720, 0xc740, 0xc740, 0xc744, 0xc744,
-    0xc74c, 0xc74c, 0xc758, 0xc758, 0xc774, 0xc774, 0xc778, 0xc778, 0xc77c, 0xc77c, 0xc785, 0xc785, 0xc791, 0xc791, 0xc7a5, 0xc7a5,
-    0xc800, 0xc801, 0xc804, 0xc804, 0xc8e0, 0xc8e0, 0xc8fc, 0xc8fc, 0xc9c0, 0xc9c0, 0xcc28, 0xcc28, 0xcd5c, 0xcd5c, 0xd070, 0xd070,
-    0xd1a0, 0xd1a0, 0xd2b8, 0xd2b8, 0xd2f4, 0xd2f4, 0xd301, 0xd301, 0xd30c, 0xd30c, 0xd328, 0xd328, 0xd3c9, 0xd3c9, 0xd558, 0xd558,
-    0xd55c, 0xd55c, 0xd574, 0xd574, 0xd654, 0xd655, 0xd6c4, 0xd6c4, 0xff01, 0xff01, 0xff0c, 0xff0c, 0xff1a, 0xff1a,
+// Input sampled by pollEvents, once per iteration of the main loop, and passed on to the next frame
+HidTouchScreenState s_touchState = {0};
+std::uint64_t s_pendingButtons = 0;
+bool s_appletEvent = false;
+
+constexpr auto fontSize       = 20.0f;
+constexpr auto fontAtlasFlags = ImFontAtlasFlags_NoPowerOfTwoHeight;
+constexpr auto fontCachePath  = "sdmc:/switch/Turnips/font_cache_%s.bin";
+
+constexpr std::array fontScriptNames = {
+    "latin", "chinese", "korean",
 };
+static_assert(fontScriptNames.size() == static_cast<std::size_t>(imgui::nx::FontScript::Count));
+
+PlFontData s_standardFont, s_chineseFont, s_koreanFont;
+
+// Atlases are built on first use of a script and kept, the context's own atlas is put back on exit
+std::array<std::unique_ptr<ImFontAtlas>, static_cast<std::size_t>(imgui::nx::FontScript::Count)> s_fontAtlases;
+ImFontAtlas *s_contextAtlas = nullptr;
+
+ImWchar const *getFontRanges(imgui::nx::FontScript script) {
+    switch (script) {
+        case imgui::nx::FontScript::Chinese:
+            return nxFontRangesChinese;
+        case imgui::nx::FontScript::Korean:
+            return nxFontRangesKorean;
+        case imgui::nx::FontScript::Latin:
+        default:
+            return nxFontRangesLatin;
+    }
+}
+
+// Everything the atlas of a script depends on
+fc::Key getFontAtlasKey(imgui::nx::FontScript script) {
+    static auto const fontHashes = std::array{
+        sv::sha256(s_standardFont.address, s_standardFont.size),
+        sv::sha256(s_chineseFont.address,  s_chineseFont.size),
+        sv::sha256(s_koreanFont.address,   s_koreanFont.size),
+    };
+
+    return fc::KeyBuilder()
+        .add(fontHashes.data(), fontHashes.size())
+        .add(fontSize)
+        .add(fontAtlasFlags)
+        .add_ranges(getFontRanges(script))
+        .finish();
+}
+
+std::unique_ptr<ImFontAtlas> buildFontAtlas(imgui::nx::FontScript script) {
+    auto const start = std::chrono::steady_clock::now();
+    auto atlas = std::make_unique<ImFontAtlas>();
+
+    auto const elapsed = [&start] {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Rasterizing is only needed when the fonts, the glyphs or ImGui changed
+    char path[0x40];
+    std::snprintf(path, sizeof(path), fontCachePath, fontScriptNames[static_cast<std::size_t>(script)]);
+    auto const key = getFontAtlasKey(script);
+    if (fc::load(path, key, *atlas)) {
+        std::printf("Loaded %s font atlas from cache: %dx%d (%d KiB) in %.1fms\n", fontScriptNames[static_cast<std::size_t>(script)],
+            atlas->TexWidth, atlas->TexHeight, atlas->TexWidth * atlas->TexHeight / 1024, elapsed());
+        return atlas;
+    }
+
+    // Only the glyphs used by the script and the language names are rasterized, the CJK and Hangul fonts
+    // provide the ones the standard font lacks
+    ImFontConfig font_cfg;
+    font_cfg.FontDataOwnedByAtlas = false;
+    atlas->AddFontFromMemoryTTF(s_standardFont.address, s_standardFont.size, fontSize, &font_cfg, getFontRanges(script));
+    font_cfg.MergeMode            = true;
+    atlas->AddFontFromMemoryTTF(s_chineseFont.address,  s_chineseFont.size,  fontSize, &font_cfg, getFontRanges(script));
+    atlas->AddFontFromMemoryTTF(s_koreanFont.address,   s_koreanFont.size,   fontSize, &font_cfg, getFontRanges(script));
+
+    // build font atlas
+    std::uint8_t *px;
+    int w, h;
+    atlas->Flags |= fontAtlasFlags;
+    atlas->GetTexDataAsAlpha8(&px, &w, &h);
+
+    std::printf("Built %s font atlas: %dx%d (%d KiB) in %.1fms\n", fontScriptNames[static_cast<std::size_t>(script)],
+        w, h, w * h / 1024, elapsed());
+
+    if (!fc::store(path, key, *atlas))
+        std::printf("Failed to write font cache %s\n", path);
+    return atlas;
+}
 
 void handleAppletHook(AppletHookType type, void *param) {
+    // focus, performance mode, etc. may change what should be on screen
+    s_appletEvent = true;
+
     if (type != AppletHookType_OnOperationMode)
         return;
 
@@ -120,20 +174,18 @@ void handleAppletHook(AppletHookType type, void *param) {
 }
 
 void updateTouch(ImGuiIO &io_) {
-    // read touch positions
-    HidTouchScreenState state = {0};
-    auto count = hidGetTouchScreenStates(&state, 1);
-    if (count < 1 || state.count < 1) {
+    // touch positions were read by pollEvents
+    if (s_touchState.count < 1) {
         io_.MouseDown[0] = false;
         return;
     }
 
     // set mouse position to touch point
-    s_mousePos = ImVec2(state.touches[0].x, state.touches[0].y);
+    s_mousePos = ImVec2(s_touchState.touches[0].x, s_touchState.touches[0].y);
     io_.MouseDown[0] = true;
 }
 
-void updateKeys(ImGuiIO &io_) {
+std::uint64_t updateKeys(ImGuiIO &io_) {
     constexpr std::array mapping = {
         std::pair(ImGuiNavInput_Activate,  HidNpadButton_A),
         std::pair(ImGuiNavInput_Cancel,    HidNpadButton_B),
@@ -149,12 +201,14 @@ void updateKeys(ImGuiIO &io_) {
         std::pair(ImGuiNavInput_DpadLeft,  HidNpadButton_Left),
     };
 
-    padUpdate(&s_pad);
-    auto down = padGetButtonsDown(&s_pad);
+    // the pad was updated by pollEvents
+    auto down = std::exchange(s_pendingButtons, 0);
 
     for (auto [im, nx]: mapping)
         if (down & nx)
             io_.NavInputs[im] = 1.0f;
+
+    return down;
 }
 
 } // namespace
@@ -165,29 +219,12 @@ bool imgui::nx::init() {
 
     auto &io = ImGui::GetIO();
 
-    // Load nintendo font
-    PlFontData standard, /* extended, */ chinese, korean;
-    // static ImWchar extended_range[] = {0xe000, 0xe152};
-    if (R_SUCCEEDED(plGetSharedFontByType(&standard,     PlSharedFontType_Standard)) &&
-            // R_SUCCEEDED(plGetSharedFontByType(&extended, PlSharedFontType_NintendoExt)) &&
-            R_SUCCEEDED(plGetSharedFontByType(&chinese,  PlSharedFontType_ChineseSimplified)) &&
-            R_SUCCEEDED(plGetSharedFontByType(&korean,   PlSharedFontType_KO))) {
-        std::uint8_t *px;
-        int w, h, bpp;
-        ImFontConfig font_cfg;
-
-        font_cfg.FontDataOwnedByAtlas = false;
-        io.Fonts->AddFontFromMemoryTTF(standard.address, standard.size, 20.0f, &font_cfg, io.Fonts->GetGlyphRangesDefault());
-        font_cfg.MergeMode            = true;
-        // io.Fonts->AddFontFromMemoryTTF(extended.address, extended.size, 20.0f, &font_cfg, extended_range);
-        io.Fonts->AddFontFromMemoryTTF(chinese.address,  chinese.size,  20.0f, &font_cfg, nxFontRanges);
-        io.Fonts->AddFontFromMemoryTTF(korean.address,   korean.size,   20.0f, &font_cfg, nxFontRanges);
-
-        // build font atlas
-        io.Fonts->GetTexDataAsAlpha8(&px, &w, &h, &bpp);
-        io.Fonts->Flags |= ImFontAtlasFlags_NoPowerOfTwoHeight;
-        io.Fonts->Build();
-    }
+    // Load nintendo font, atlases are built by setFontScript
+    if (R_FAILED(plGetSharedFontByType(&s_standardFont, PlSharedFontType_Standard)) ||
+            R_FAILED(plGetSharedFontByType(&s_chineseFont,  PlSharedFontType_ChineseSimplified)) ||
+            R_FAILED(plGetSharedFontByType(&s_koreanFont,   PlSharedFontType_KO)))
+        s_standardFont = s_chineseFont = s_koreanFont = {};
+    s_contextAtlas = io.Fonts;
 
     auto &style = ImGui::GetStyle();
     style.WindowRounding = 0.0f;
@@ -221,6 +258,18 @@ bool imgui::nx::init() {
     return true;
 }
 
+bool imgui::nx::setFontScript(FontScript script) {
+    auto &atlas = s_fontAtlases[static_cast<std::size_t>(script)];
+
+    // Without the shared fonts, the context's atlas is kept, with the ImGui default font
+    auto is_new = !atlas && s_standardFont.address;
+    if (is_new)
+        atlas = buildFontAtlas(script);
+
+    ImGui::GetIO().Fonts = atlas ? atlas.get() : s_contextAtlas;
+    return is_new;
+}
+
 std::uint64_t imgui::nx::newFrame() {
     auto &io = ImGui::GetIO();
 
@@ -238,17 +287,32 @@ std::uint64_t imgui::nx::newFrame() {
 
     // update inputs
     updateTouch(io);
-    updateKeys(io);
+    auto down = updateKeys(io);
 
     // clamp mouse to screen
     s_mousePos.x = std::clamp(s_mousePos.x, 0.0f, s_width);
     s_mousePos.y = std::clamp(s_mousePos.y, 0.0f, s_height);
     io.MousePos  = s_mousePos;
 
-    return padGetButtonsDown(&s_pad);
+    return down;
+}
+
+bool imgui::nx::pollEvents() {
+    padUpdate(&s_pad);
+    s_pendingButtons |= padGetButtonsDown(&s_pad);
+
+    if (hidGetTouchScreenStates(&s_touchState, 1) < 1)
+        s_touchState.count = 0;
+
+    return padGetButtons(&s_pad) || (s_touchState.count > 0) || std::exchange(s_appletEvent, false);
 }
 
 void imgui::nx::exit() {
     // deinitialize applet hooks
     appletUnhook(&s_appletHookCookie);
+
+    // the cached atlases are not owned by the context
+    ImGui::GetIO().Fonts = s_contextAtlas;
+    for (auto &atlas: s_fontAtlases)
+        atlas = nullptr;
 }
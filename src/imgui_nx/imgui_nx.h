@@ -31,8 +31,26 @@
 
 namespace imgui::nx {
 
+// Font atlases are split by script, so that only the glyphs of the current language are rasterized
+enum class FontScript {
+    Latin,
+    Chinese, // Chinese and Japanese
+    Korean,
+    Count,
+};
+
 bool init();
 void exit();
+
+// Feeds ImGui the input sampled by the last pollEvents call, returns the buttons pressed since the last frame
 std::uint64_t newFrame();
 
+// Samples the pad and touch screen, call once before each frame and while waiting between frames
+// Returns whether there was input or an applet event since the last call
+bool pollEvents();
+
+// Makes the atlas of the script current, building it on first use. Call between frames
+// Returns whether a new atlas was built, which then needs to be uploaded by the renderer
+bool setFontScript(FontScript script);
+
 } // namespace imgui::nx
@@ -0,0 +1,198 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "platform.hpp"
+
+// Opt-in instrumentation of the fs:: wrappers (build with FS_STATS=1): call counts, bytes and latency histograms
+// per operation, process-wide. Without FS_STATS, the probes are empty and compile to nothing, and the queries
+// report zeroes
+namespace fs::stats {
+
+enum class Op {
+    Open,       // Files and directories
+    Read,       // Reads reaching the backend
+    CachedRead, // Reads going through the page cache, hit or miss
+    Map,        // Successful mappings count the mapped size as bytes
+    Write,
+    Flush,
+    DirRead,    // One page of directory entries
+    Stat,       // Entry type and timestamp queries
+    Create,
+    Rename,
+    Delete,
+    Commit,
+    Count,
+};
+
+constexpr std::array op_names = {
+    "open", "read", "cached_read", "map", "write", "flush", "dir_read", "stat", "create", "rename", "delete", "commit",
+};
+static_assert(op_names.size() == static_cast<std::size_t>(Op::Count));
+
+// Bucket i holds the calls that took [2^i, 2^(i+1)) ns, the last one everything above
+constexpr std::size_t num_buckets = 32;
+
+struct OpStats {
+    std::uint64_t calls = 0, bytes = 0, total_ns = 0, max_ns = 0;
+    std::array<std::uint64_t, num_buckets> buckets = {};
+
+    // Upper bound of the bucket holding the given fraction of the calls
+    inline std::uint64_t percentile_ns(double fraction) const {
+        auto target = static_cast<std::uint64_t>(fraction * this->calls), seen = std::uint64_t(0);
+        for (std::size_t i = 0; i < num_buckets; ++i)
+            if ((seen += this->buckets[i]) > target)
+                return std::min(std::uint64_t(2) << i, this->max_ns);
+        return this->max_ns;
+    }
+};
+
+#ifdef FS_STATS
+
+constexpr bool is_enabled = true;
+
+namespace detail {
+
+struct Counters {
+    std::atomic<std::uint64_t> calls = 0, bytes = 0, total_ns = 0, max_ns = 0;
+    std::array<std::atomic<std::uint64_t>, num_buckets> buckets = {};
+};
+
+inline std::array<Counters, static_cast<std::size_t>(Op::Count)> counters;
+
+inline std::size_t get_bucket(std::uint64_t ns) {
+    return ns ? std::min(num_buckets - 1, static_cast<std::size_t>(63 - __builtin_clzll(ns))) : 0;
+}
+
+} // namespace detail
+
+inline void record(Op op, std::uint64_t ns, std::size_t bytes = 0) {
+    auto &c = detail::counters[static_cast<std::size_t>(op)];
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    c.buckets[detail::get_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    auto max = c.max_ns.load(std::memory_order_relaxed);
+    while ((ns > max) && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+}
+
+// Times the enclosing scope, the byte count can be set once the operation completed
+class Probe {
+    private:
+        Op            op;
+        std::size_t   bytes;
+        std::uint64_t start = now_ns();
+
+    public:
+        inline Probe(Op op, std::size_t bytes = 0): op(op), bytes(bytes) { }
+
+        inline ~Probe() {
+            record(this->op, now_ns() - this->start, this->bytes);
+        }
+
+        inline void set_bytes(std::size_t bytes) {
+            this->bytes = bytes;
+        }
+};
+
+inline OpStats get(Op op) {
+    auto &c = detail::counters[static_cast<std::size_t>(op)];
+    OpStats s;
+    s.calls    = c.calls.load(std::memory_order_relaxed);
+    s.bytes    = c.bytes.load(std::memory_order_relaxed);
+    s.total_ns = c.total_ns.load(std::memory_order_relaxed);
+    s.max_ns   = c.max_ns.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < num_buckets; ++i)
+        s.buckets[i] = c.buckets[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+inline void reset() {
+    for (auto &c: detail::counters) {
+        c.calls = 0, c.bytes = 0, c.total_ns = 0, c.max_ns = 0;
+        for (auto &b: c.buckets)
+            b = 0;
+    }
+}
+
+#else
+
+constexpr bool is_enabled = false;
+
+inline void record(Op, std::uint64_t, std::size_t = 0) { }
+
+class Probe {
+    public:
+        constexpr inline Probe(Op, std::size_t = 0) { }
+        constexpr inline void set_bytes(std::size_t) { }
+};
+
+inline OpStats get(Op) {
+    return {};
+}
+
+inline void reset() { }
+
+#endif // FS_STATS
+
+// Table of every operation that was called, then the latency histogram of each
+inline void dump(std::FILE *fp) {
+    if (!is_enabled) {
+        std::fprintf(fp, "I/O stats disabled, build with FS_STATS=1\n");
+        return;
+    }
+
+    std::fprintf(fp, "%-12s %8s %12s %10s %9s %9s %9s %9s\n", "op", "calls", "bytes", "total ms", "avg us", "p50 us", "p99 us", "max us");
+    for (std::size_t i = 0; i < op_names.size(); ++i) {
+        auto s = get(static_cast<Op>(i));
+        if (!s.calls)
+            continue;
+        std::fprintf(fp, "%-12s %8lu %12lu %10.3f %9.1f %9.1f %9.1f %9.1f\n", op_names[i],
+            static_cast<unsigned long>(s.calls), static_cast<unsigned long>(s.bytes), s.total_ns / 1e6,
+            s.total_ns / 1e3 / s.calls, s.percentile_ns(0.5) / 1e3, s.percentile_ns(0.99) / 1e3, s.max_ns / 1e3);
+    }
+
+    for (std::size_t i = 0; i < op_names.size(); ++i) {
+        auto s = get(static_cast<Op>(i));
+        if (!s.calls)
+            continue;
+        std::fprintf(fp, "\n%s:\n", op_names[i]);
+        for (std::size_t j = 0; j < num_buckets; ++j)
+            if (s.buckets[j])
+                std::fprintf(fp, "  < %10.1fus %8lu\n", (std::uint64_t(2) << j) / 1e3, static_cast<unsigned long>(s.buckets[j]));
+    }
+}
+
+inline bool dump(const std::string &path) {
+    auto *fp = std::fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+    dump(fp);
+    std::fclose(fp);
+    return true;
+}
+
+} // namespace fs::stats
@@ -0,0 +1,90 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "parser.hpp"
+#include "locator.hpp"
+#include "save_view.hpp"
+
+namespace tp {
+
+// Sections parsed from a decrypted save
+// Everything is parsed up front, so that the caller can free the decrypted data right after
+class IslandSnapshot {
+    private:
+        inline static std::uint32_t next_generation = 0;
+
+        std::uint32_t     generation = 0;
+        Version           version = Version::Unknown;
+
+        TurnipParser      turnip_parser;
+        VisitorParser     visitor_parser;
+        DateParser        date_parser;
+        WeatherSeedParser weather_parser;
+
+    public:
+        IslandSnapshot() = default;
+        IslandSnapshot(Version version, const sv::SaveView &save):
+            generation(++next_generation), version(version), turnip_parser(locate_turnips(version, save)),
+            visitor_parser(version, save), date_parser(version, save), weather_parser(version, save) { }
+
+        // Tells snapshots apart, so that what is computed from their data can be cached
+        inline std::uint32_t get_generation() const {
+            return this->generation;
+        }
+
+        inline Version get_version() const {
+            return this->version;
+        }
+
+        inline const TurnipParser &turnips() const {
+            return this->turnip_parser;
+        }
+
+        inline const VisitorParser &visitors() const {
+            return this->visitor_parser;
+        }
+
+        inline const DateParser &date() const {
+            return this->date_parser;
+        }
+
+        inline const WeatherSeedParser &weather() const {
+            return this->weather_parser;
+        }
+
+    private:
+        static TurnipParser locate_turnips(Version version, const sv::SaveView &save) {
+            if (version != Version::Unknown)
+                return TurnipParser(version, save);
+
+            // Only the turnip prices can be located, the other sections stay unavailable
+            auto candidates = TurnipLocator::locate(save, TurnipParser::get_offset(Version::Unknown));
+            if (candidates.empty()) {
+                printf("Unknown save version, turnip prices not found\n");
+                return TurnipParser();
+            }
+            printf("Unknown save version, turnip prices found at %#lx\n", candidates.front().offset);
+            return TurnipParser(version, save, candidates.front().offset);
+        }
+};
+
+} // namespace tp
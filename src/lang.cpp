@@ -15,101 +15,285 @@
 // You should have received a copy of the GNU General Public License
 // along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <switch.h>
-#include <json.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "fs.hpp"
 #include "lang.hpp"
-
-using json = nlohmann::json;
+#include "platform.hpp"
 
 namespace lang {
 
 namespace {
 
-static json lang_json = nullptr;
-static Language current_language = Language::Default;
+// Custom module, distinct from the one of backup.cpp
+constexpr inline Result make_result(std::uint32_t desc) {
+    return 0x1fe | (desc << 9);
+}
 
-} // namespace
+constexpr Result ResultInvalidTable = make_result(1);
 
-const json &get_json() {
-    return lang_json;
-}
+// View of a language file compiled by misc/compile_lang.py: sorted key hashes, then keys and values as offsets
+// into a blob of strings
+class StringTable {
+    public:
+        constexpr static std::uint32_t magic   = 0x474c5054; // "TPLG"
+        constexpr static std::uint32_t version = 2;
 
-Language get_current_language() {
-    return current_language;
-}
+        struct Header {
+            std::uint32_t magic, version;
+            std::uint32_t num_strings, blob_size;
+        };
 
-Result set_language(Language lang) {
-    const char *path;
-    current_language = lang;
+    private:
+        const std::uint32_t *hashes = nullptr, *key_offsets = nullptr, *value_offsets = nullptr;
+        const char          *blob = nullptr;
+        std::uint32_t        num_strings = 0;
+        std::size_t          size = 0;
+
+    public:
+        // Points the view at a table after checking it, so that lookups don't need any checks
+        // The data must be 4-byte aligned, and outlive the view
+        bool load(const std::uint8_t *data, std::size_t size) {
+            if (size < sizeof(Header))
+                return false;
+
+            Header hdr;
+            std::memcpy(&hdr, data, sizeof(hdr));
+            if ((hdr.magic != magic) || (hdr.version != version) || !hdr.blob_size
+                    || (size != sizeof(Header) + 3 * sizeof(std::uint32_t) * std::uint64_t(hdr.num_strings) + hdr.blob_size))
+                return false;
+
+            auto *offsets = reinterpret_cast<const std::uint32_t *>(data + sizeof(Header)) + hdr.num_strings;
+            auto *strings = reinterpret_cast<const char *>(offsets + 2 * hdr.num_strings);
+            if (strings[hdr.blob_size - 1] != '\0')
+                return false;
+            for (std::size_t i = 0; i < 2 * hdr.num_strings; ++i)
+                if (offsets[i] >= hdr.blob_size)
+                    return false;
+
+            this->hashes        = reinterpret_cast<const std::uint32_t *>(data + sizeof(Header));
+            this->key_offsets   = this->hashes + hdr.num_strings;
+            this->value_offsets = this->key_offsets + hdr.num_strings;
+            this->blob          = reinterpret_cast<const char *>(this->value_offsets + hdr.num_strings);
+            this->num_strings   = hdr.num_strings;
+            this->size          = size;
+            return true;
+        }
+
+        inline bool is_valid() const {
+            return this->size;
+        }
+
+        inline std::size_t get_size() const {
+            return this->size;
+        }
+
+        // Hashes are unique within a table, the key comparison rejects missing keys that collide with another one
+        const char *find(std::uint32_t hash, std::string_view section, std::string_view key) const {
+            auto *end = this->hashes + this->num_strings;
+            auto *it  = std::lower_bound(this->hashes, end, hash);
+            if ((it == end) || (*it != hash))
+                return nullptr;
+
+            auto idx = it - this->hashes;
+            if (!matches(this->blob + this->key_offsets[idx], section, key))
+                return nullptr;
+            return this->blob + this->value_offsets[idx];
+        }
+
+    private:
+        // Whether a stored key is section + "." + key (or only key with an empty section)
+        static bool matches(const char *stored, std::string_view section, std::string_view key) {
+            auto match_part = [&stored](std::string_view part) {
+                // Stops at the end of the stored key, which can't match since the parts don't contain NULs
+                for (char c: part)
+                    if (*stored++ != c)
+                        return false;
+                return true;
+            };
+
+            if (!section.empty() && !(match_part(section) && match_part(".")))
+                return false;
+            return match_part(key) && !*stored;
+        }
+};
+
+constexpr std::size_t num_languages = static_cast<std::size_t>(Language::Default);
+
+// Every language table, read once in a single allocation on the I/O worker. Switching languages only swaps the
+// current table, at the frame boundary
+static std::vector<std::uint8_t>              arena;
+static std::array<StringTable, num_languages> tables;
+static bool                                   is_loaded = false;
+static fs::AsyncRead                          pending_load;
+
+static std::atomic<const StringTable *> current_table    = nullptr;
+static std::atomic<Language>            current_language = Language::Default; // Last accepted request
+static bool                             has_request      = false;
+static std::atomic<std::uint32_t>       generation       = 0;
+
+const char *get_path(Language lang) {
     switch (lang) {
         case Language::ChineseSimplified:
-            path = "romfs:/lang/zh-cn.json";
-            break;
+            return ROMFS_ROOT "lang/zh-cn.bin";
         case Language::ChineseTraditional:
-            path = "romfs:/lang/zh-tw.json";
-            break;
+            return ROMFS_ROOT "lang/zh-tw.bin";
         case Language::Japanese:
-            path = "romfs:/lang/ja.json";
-            break;
+            return ROMFS_ROOT "lang/ja.bin";
         case Language::JapaneseRyukyuan:
-            path = "romfs:/lang/ja-ryu.json";
-            break;
+            return ROMFS_ROOT "lang/ja-ryu.bin";
         case Language::French:
-            path = "romfs:/lang/fr.json";
-            break;
+            return ROMFS_ROOT "lang/fr.bin";
         case Language::Dutch:
-            path = "romfs:/lang/nl.json";
-            break;
+            return ROMFS_ROOT "lang/nl.bin";
         case Language::Italian:
-            path = "romfs:/lang/it.json";
-            break;
+            return ROMFS_ROOT "lang/it.bin";
         case Language::German:
-            path = "romfs:/lang/de.json";
-            break;
+            return ROMFS_ROOT "lang/de.bin";
         case Language::Spanish:
-            path = "romfs:/lang/es.json";
-            break;
+            return ROMFS_ROOT "lang/es.bin";
         case Language::Korean:
-            path = "romfs:/lang/ko.json";
-            break;
+            return ROMFS_ROOT "lang/ko.bin";
         case Language::Portuguese:
-            path = "romfs:/lang/pt-br.json";
-            break;
+            return ROMFS_ROOT "lang/pt-br.bin";
         case Language::Latin:
-            path = "romfs:/lang/la.json";
-            break;
+            return ROMFS_ROOT "lang/la.bin";
         case Language::Polish:
-            path = "romfs:/lang/pl.json";
-            break;
+            return ROMFS_ROOT "lang/pl.bin";
         case Language::English:
         case Language::Default:
         default:
-            path = "romfs:/lang/en.json";
-            break;
+            return ROMFS_ROOT "lang/en.bin";
     }
+}
+
+constexpr std::size_t get_index(Language lang) {
+    return (lang == Language::Default) ? static_cast<std::size_t>(Language::English) : static_cast<std::size_t>(lang);
+}
 
-    auto *fp = fopen(path, "r");
+std::size_t get_file_size(const char *path) {
+    auto *fp = fopen(path, "rb");
     if (!fp)
-        return 1;
+        return 0;
 
     fseek(fp, 0, SEEK_END);
     std::size_t size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    fclose(fp);
+    return size;
+}
 
-    std::string contents(size, 0);
+// Sizes every table first so that the arena is allocated once, returns the number of valid tables
+std::size_t load_tables() {
+    std::array<std::size_t, num_languages> offsets, sizes;
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < num_languages; ++i) {
+        sizes[i]   = get_file_size(get_path(static_cast<Language>(i)));
+        offsets[i] = total;
+        total     += (sizes[i] + 3) & ~std::size_t(3); // Keeps the tables aligned for their u32 arrays
+    }
 
-    if (auto read = fread(contents.data(), 1, size, fp); read != size)
-        return read;
-    fclose(fp);
+    arena.resize(total);
+
+    std::size_t num_valid = 0;
+    for (std::size_t i = 0; i < num_languages; ++i) {
+        auto *fp = fopen(get_path(static_cast<Language>(i)), "rb");
+        if (!fp)
+            continue;
+        auto read = fread(arena.data() + offsets[i], 1, sizes[i], fp);
+        fclose(fp);
+
+        num_valid += tables[i].load(arena.data() + offsets[i], read);
+    }
+    return num_valid;
+}
 
-    lang_json = json::parse(contents);
+// Returns whether the tables are loaded, starting the load if needed
+bool finish_load(bool wait) {
+    if (is_loaded)
+        return true;
 
+    prefetch();
+    if (!wait && !pending_load.is_done())
+        return false;
+
+    pending_load.wait(), pending_load = fs::AsyncRead();
+    is_loaded = true;
+
+    auto report = get_memory_report();
+    printf("Loaded %zu languages in %zu bytes (largest %zu bytes)\n", report.num_tables, report.arena_size, report.largest_table);
+    return true;
+}
+
+} // namespace
+
+Language get_current_language() {
+    return current_language;
+}
+
+void prefetch() {
+    if (!is_loaded && !pending_load.is_valid())
+        pending_load = fs::AsyncRead(load_tables);
+}
+
+Result set_language(Language lang) {
+    if (is_loaded && !tables[get_index(lang)].is_valid())
+        return ResultInvalidTable;
+    current_language = lang, has_request = true;
     return 0;
 }
 
-Result initialize_to_system_language() {
+bool update(bool wait) {
+    if (!has_request || !finish_load(wait))
+        return false;
+    has_request = false;
+
+    auto &table = tables[get_index(current_language)];
+    if (!table.is_valid()) {
+        // Requested before the tables were loaded, go back to the language in use
+        printf("Invalid language table for language %zu\n", get_index(current_language));
+        auto *cur = current_table.load(std::memory_order_acquire);
+        current_language = cur ? static_cast<Language>(cur - tables.data()) : Language::Default;
+        return false;
+    }
+
+    if (current_table.exchange(&table, std::memory_order_acq_rel) == &table)
+        return false;
+    generation.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+std::uint32_t get_generation() {
+    return generation.load(std::memory_order_acquire);
+}
+
+MemoryReport get_memory_report() {
+    // The worker is still writing the arena, report nothing rather than block the caller
+    MemoryReport report = {};
+    if (!finish_load(false))
+        return report;
+
+    report.is_complete = true;
+    report.arena_size = arena.size();
+    for (auto &table: tables) {
+        report.num_tables   += table.is_valid();
+        report.largest_table = std::max(report.largest_table, table.get_size());
+    }
+    return report;
+}
+
+Result get_system_language(Language &lang) {
+#ifndef __SWITCH__
+    lang = Language::Default;
+    return 0;
+#else
     if (auto rc = setInitialize(); R_FAILED(rc)) {
         setExit();
         return rc;
@@ -130,37 +314,68 @@ Result initialize_to_system_language() {
     switch (sl) {
         case SetLanguage_ENGB:
         case SetLanguage_ENUS:
-            return set_language(Language::English);
+            lang = Language::English;
+            break;
         case SetLanguage_ZHCN:
         case SetLanguage_ZHHANS:
-            return set_language(Language::ChineseSimplified);
+            lang = Language::ChineseSimplified;
+            break;
         case SetLanguage_ZHTW:
         case SetLanguage_ZHHANT:
-            return set_language(Language::ChineseTraditional);
+            lang = Language::ChineseTraditional;
+            break;
         case SetLanguage_JA:
-            return set_language(Language::Japanese);
+            lang = Language::Japanese;
+            break;
         case SetLanguage_FR:
-            return set_language(Language::French);
+            lang = Language::French;
+            break;
         case SetLanguage_NL:
-            return set_language(Language::Dutch);
+            lang = Language::Dutch;
+            break;
         case SetLanguage_IT:
-            return set_language(Language::Italian);
+            lang = Language::Italian;
+            break;
         case SetLanguage_DE:
-            return set_language(Language::German);
+            lang = Language::German;
+            break;
         case SetLanguage_ES:
-            return set_language(Language::Spanish);
+            lang = Language::Spanish;
+            break;
         case SetLanguage_KO:
-            return set_language(Language::Korean);
+            lang = Language::Korean;
+            break;
         case SetLanguage_PT:
         case SetLanguage_PTBR:
-            return set_language(Language::Portuguese);
+            lang = Language::Portuguese;
+            break;
         default:
-            return set_language(Language::Default);
+            lang = Language::Default;
+            break;
     }
+
+    setExit();
+    return 0;
+#endif
+}
+
+Result initialize_to_system_language() {
+    Language lang;
+    if (auto rc = get_system_language(lang); R_FAILED(rc))
+        return rc;
+    return set_language(lang);
+}
+
+const char *get_string(Key key) {
+    auto *table = current_table.load(std::memory_order_acquire);
+    auto *str   = table ? table->find(key.hash, {}, {key.str, key.size}) : nullptr;
+    return str ? str : key.str;
 }
 
-std::string get_string(std::string key, const json &json) {
-    return json.value(key, key);
+const char *get_string(const char *section, const char *key) {
+    auto *table = current_table.load(std::memory_order_acquire);
+    auto *str   = table ? table->find(hash(key, hash(".", hash(section))), section, key) : nullptr;
+    return str ? str : key;
 }
 
 } // namespace lang
@@ -17,8 +17,12 @@
 
 #pragma once
 
-#include <string>
-#include <json.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+
+#include "platform.hpp"
 
 namespace lang {
 
@@ -40,18 +44,77 @@ enum class Language {
     Default,
 };
 
-const nlohmann::json &get_json();
-
 Language get_current_language();
+Result get_system_language(Language &lang);
+
+// Language tables are all loaded together in the background, starting with prefetch
+// set_language only requests a language, and update applies it once the tables are loaded: call it at the start
+// of a frame so that the whole frame uses the same language. Until then, lookups return key names
+// A language whose table failed to load is refused, and the current language is kept
+void prefetch();
 Result set_language(Language lang);
 Result initialize_to_system_language();
 
-std::string get_string(std::string key, const nlohmann::json &json = get_json());
+// Returns whether the language changed, `wait` blocks until the tables are loaded
+bool update(bool wait = false);
+
+// Changes whenever update switches the language, so that translated text can be cached
+std::uint32_t get_generation();
+
+struct MemoryReport {
+    std::size_t arena_size;    // Every table, in a single allocation
+    std::size_t largest_table; // What keeping only the current language would take
+    std::size_t num_tables;    // Tables that loaded successfully
+    bool        is_complete;   // False while the tables are loading, the sizes are then all zero
+};
+
+// Doesn't wait for the tables to load
+MemoryReport get_memory_report();
+
+// 32-bit FNV-1a, as used by misc/compile_lang.py to index the tables
+constexpr std::uint32_t fnv_basis = 0x811c9dc5, fnv_prime = 0x01000193;
+
+constexpr inline std::uint32_t hash(std::string_view str, std::uint32_t h = fnv_basis) {
+    for (unsigned char c: str)
+        h = (h ^ c) * fnv_prime;
+    return h;
+}
+
+// Dotted key ("days.monday") with its hash, computed at compile time for literals
+struct Key {
+    const char    *str;
+    std::size_t    size;
+    std::uint32_t  hash;
+
+    constexpr inline Key(const char *str, std::size_t size): str(str), size(size), hash(lang::hash({str, size})) { }
+    constexpr inline Key(const char *str): Key(str, std::string_view(str).size()) { }
+};
+
+// Translation of a key, or the key itself if the current language doesn't have it
+// The string lives in the language tables, which are never freed, so it stays valid for the whole program
+const char *get_string(Key key);
+const char *get_string(const char *section, const char *key);
 
 namespace literals {
 
-inline std::string operator ""_lang(const char *key, size_t size) {
-    return get_string(std::string(key, size));
+namespace detail {
+
+template <std::size_t N>
+struct Literal {
+    char str[N];
+
+    consteval Literal(const char (&str)[N]) {
+        std::copy_n(str, N, this->str);
+    }
+};
+
+} // namespace detail
+
+// Allocation-free lookup, the key hash is a constant
+template <detail::Literal L>
+inline const char *operator ""_lang() {
+    constexpr auto key = Key(L.str, sizeof(L.str) - 1);
+    return get_string(key);
 }
 
 } // namespace literals
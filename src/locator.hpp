@@ -0,0 +1,146 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#ifdef __ARM_NEON
+#   include <arm_neon.h>
+#endif
+
+#include "parser.hpp"
+#include "save_view.hpp"
+
+namespace tp {
+
+// Heuristic search for structures in saves from game versions we don't have offsets for
+// Candidates are found with a vectorized coarse filter on a few fields, then verified and ranked
+class TurnipLocator {
+    public:
+        struct Candidate {
+            std::size_t   offset;
+            std::uint32_t score;
+        };
+
+    private:
+        constexpr static std::uint32_t buy_price_min  = 90,  buy_price_max  = 110;
+        constexpr static std::uint32_t sell_price_min = 10,  sell_price_max = 700;
+        constexpr static std::uint32_t pattern_max    = 4;
+
+        // Word indices of the fields checked by the coarse filter
+        constexpr static std::size_t buy_price_idx    = offsetof(TurnipPrices, buy_price)    / sizeof(std::uint32_t);
+        constexpr static std::size_t pattern_type_idx = offsetof(TurnipPrices, pattern_type) / sizeof(std::uint32_t);
+        constexpr static std::size_t struct_words     = sizeof(TurnipPrices)                 / sizeof(std::uint32_t);
+
+        constexpr static std::size_t max_candidates   = 16;
+
+    public:
+        // Returns candidate offsets, best first
+        // Ties are broken by distance to the hint, usually the offset for the most recent known version
+        static std::vector<Candidate> locate(const sv::SaveView &save, std::size_t hint) {
+            std::vector<Candidate> candidates;
+            if (save.size() < sizeof(TurnipPrices))
+                return candidates;
+
+            auto *words = reinterpret_cast<const std::uint32_t *>(save.data());
+            std::size_t num_words = save.size() / sizeof(std::uint32_t) - struct_words + 1, i = 0;
+
+            auto check = [&](std::size_t idx) {
+                if (auto score = score_candidate(&words[idx]); score)
+                    candidates.push_back({save.begin_offset() + idx * sizeof(std::uint32_t), score});
+            };
+
+#ifdef __ARM_NEON
+            auto buy_min   = vdupq_n_u32(buy_price_min);
+            auto buy_range = vdupq_n_u32(buy_price_max - buy_price_min);
+            auto pat_max   = vdupq_n_u32(pattern_max);
+
+            // Test 4 consecutive offsets per iteration: buy_price in range, pattern_type in range
+            for (; i + 4 <= num_words; i += 4) {
+                auto buy  = vld1q_u32(&words[i + buy_price_idx]);
+                auto pat  = vld1q_u32(&words[i + pattern_type_idx]);
+                auto mask = vandq_u32(vcleq_u32(vsubq_u32(buy, buy_min), buy_range), vcltq_u32(pat, pat_max));
+                if (!vmaxvq_u32(mask))
+                    continue;
+
+                for (std::size_t j = 0; j < 4; ++j)
+                    check(i + j);
+            }
+#endif
+
+            for (; i < num_words; ++i) {
+                if ((words[i + buy_price_idx] - buy_price_min <= buy_price_max - buy_price_min)
+                        && (words[i + pattern_type_idx] < pattern_max))
+                    check(i);
+            }
+
+            std::sort(candidates.begin(), candidates.end(), [hint](const Candidate &lhs, const Candidate &rhs) {
+                if (lhs.score != rhs.score)
+                    return lhs.score > rhs.score;
+                return distance(lhs.offset, hint) < distance(rhs.offset, hint);
+            });
+
+            if (candidates.size() > max_candidates)
+                candidates.resize(max_candidates);
+            return candidates;
+        }
+
+    private:
+        constexpr static inline std::size_t distance(std::size_t a, std::size_t b) {
+            return (a > b) ? a - b : b - a;
+        }
+
+        // Returns 0 if the candidate is rejected, otherwise a plausibility score
+        static std::uint32_t score_candidate(const std::uint32_t *words) {
+            auto &prices = *reinterpret_cast<const TurnipPrices *>(words);
+
+            if ((prices.buy_price - buy_price_min > buy_price_max - buy_price_min) || (prices.pattern_type >= pattern_max))
+                return 0;
+
+            // Sunday has no sell prices, the 12 other half-days must be plausible
+            for (std::size_t i = 2; i < prices.week_prices.size(); ++i)
+                if ((prices.week_prices[i] < sell_price_min) || (prices.week_prices[i] > sell_price_max))
+                    return 0;
+
+            std::uint32_t score = 1;
+
+            if (prices.sunday_am_price == prices.sunday_pm_price)
+                ++score;
+            if ((prices.sunday_am_price == 0) || (prices.sunday_am_price == prices.buy_price))
+                ++score;
+
+            // The decreasing pattern never goes up, and is the only one that doesn't
+            bool is_decreasing = std::is_sorted(prices.week_prices.rbegin(), prices.week_prices.rend() - 2);
+            if (is_decreasing == (prices.pattern_type == 2))
+                score += 2;
+
+            // Spike patterns have a peak well above the buy price, the decreasing one never exceeds it
+            auto max = *std::max_element(prices.week_prices.begin() + 2, prices.week_prices.end());
+            if ((prices.pattern_type == 1) || (prices.pattern_type == 3))
+                score += (max > prices.buy_price) ? 1 : 0;
+            else if (prices.pattern_type == 2)
+                score += (max < prices.buy_price) ? 1 : 0;
+
+            return score;
+        }
+};
+
+} // namespace tp
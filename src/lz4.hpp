@@ -0,0 +1,183 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace lz {
+
+// Compressor/decompressor for the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+// for independent blocks of at most a few MiB. Single-pass greedy matching, favouring speed over ratio
+// Each call is self-contained, so blocks can be processed on separate threads
+
+constexpr std::size_t min_match     = 4;
+constexpr std::size_t last_literals = 5;  // The last 5 bytes are always literals
+constexpr std::size_t match_limit   = 12; // No match starts in the last 12 bytes
+constexpr std::size_t max_distance  = 0xffff;
+constexpr unsigned    hash_bits     = 14;
+
+constexpr inline std::size_t max_compressed_size(std::size_t size) {
+    return size + size / 255 + 16;
+}
+
+namespace detail {
+
+inline std::uint32_t read32(const std::uint8_t *p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline std::uint32_t hash(std::uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - hash_bits);
+}
+
+inline std::uint8_t *write_length(std::uint8_t *out, std::size_t len) {
+    for (; len >= 0xff; len -= 0xff)
+        *out++ = 0xff;
+    *out++ = len;
+    return out;
+}
+
+} // namespace detail
+
+// Returns the compressed size, `dst` must hold max_compressed_size(size) bytes
+inline std::size_t compress(const std::uint8_t *src, std::size_t size, std::uint8_t *dst) {
+    auto *out = dst;
+    const auto *anchor = src, *end = src + size;
+
+    auto emit = [&out](const std::uint8_t *lit, std::size_t lit_len, std::size_t offset, std::size_t match_len) {
+        auto *token = out++;
+        *token = ((lit_len >= 0xf) ? 0xf : lit_len) << 4;
+        if (lit_len >= 0xf)
+            out = detail::write_length(out, lit_len - 0xf);
+        if (lit_len)
+            std::memcpy(out, lit, lit_len);
+        out += lit_len;
+
+        if (!match_len)
+            return;
+        *out++ = offset & 0xff, *out++ = offset >> 8;
+        match_len -= min_match;
+        *token |= (match_len >= 0xf) ? 0xf : match_len;
+        if (match_len >= 0xf)
+            out = detail::write_length(out, match_len - 0xf);
+    };
+
+    if (size > match_limit) {
+        std::vector<std::uint32_t> table(1 << hash_bits, 0);
+        const auto *match_end = end - match_limit, *ip = src + 1;
+
+        while (ip < match_end) {
+            auto seq = detail::read32(ip);
+            auto &slot = table[detail::hash(seq)];
+            const auto *ref = src + slot;
+            slot = ip - src;
+
+            if ((ref >= ip) || (ip - ref > static_cast<std::ptrdiff_t>(max_distance)) || (detail::read32(ref) != seq)) {
+                ++ip;
+                continue;
+            }
+
+            // Extend backwards over pending literals, then forwards up to the end-of-block restriction
+            while ((ip > anchor) && (ref > src) && (ip[-1] == ref[-1]))
+                --ip, --ref;
+            auto len = min_match;
+            while ((ip + len < end - last_literals) && (ip[len] == ref[len]))
+                ++len;
+
+            emit(anchor, ip - anchor, ip - ref, len);
+            ip += len, anchor = ip;
+
+            if (ip < match_end)
+                table[detail::hash(detail::read32(ip - 2))] = ip - 2 - src;
+        }
+    }
+
+    emit(anchor, end - anchor, 0, 0);
+    return out - dst;
+}
+
+inline std::vector<std::uint8_t> compress(const std::uint8_t *src, std::size_t size) {
+    std::vector<std::uint8_t> res(max_compressed_size(size));
+    res.resize(compress(src, size, res.data()));
+    return res;
+}
+
+// Returns false on malformed input, or if the output doesn't exactly fill `dst_size` bytes
+inline bool decompress(const std::uint8_t *src, std::size_t size, std::uint8_t *dst, std::size_t dst_size) {
+    const auto *ip = src, *ip_end = src + size;
+    auto *op = dst, *op_end = dst + dst_size;
+
+    auto read_length = [&ip, ip_end](std::size_t len) -> std::size_t {
+        if (len != 0xf)
+            return len;
+        std::uint8_t b;
+        do {
+            if (ip >= ip_end)
+                return SIZE_MAX;
+            len += b = *ip++;
+        } while (b == 0xff);
+        return len;
+    };
+
+    while (ip < ip_end) {
+        auto token = *ip++;
+
+        auto lit_len = read_length(token >> 4);
+        if ((lit_len > static_cast<std::size_t>(ip_end - ip)) || (lit_len > static_cast<std::size_t>(op_end - op)))
+            return false;
+        if (lit_len)
+            std::memcpy(op, ip, lit_len);
+        ip += lit_len, op += lit_len;
+
+        if (ip == ip_end)
+            break;
+
+        if (ip_end - ip < 2)
+            return false;
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (!offset || (offset > static_cast<std::size_t>(op - dst)))
+            return false;
+
+        auto match_len = read_length(token & 0xf);
+        if (match_len == SIZE_MAX)
+            return false;
+        match_len += min_match;
+        if (match_len > static_cast<std::size_t>(op_end - op))
+            return false;
+
+        // Overlapping matches repeat the last `offset` bytes: copy from the start of the match in steps that
+        // don't overlap, each doubling the periodic run available as source
+        const auto *ref = op - offset;
+        for (std::size_t done = 0, step; done < match_len; done += step) {
+            step = std::min(match_len - done, offset + done);
+            std::memcpy(op + done, ref, step);
+        }
+        op += match_len;
+    }
+
+    return op == op_end;
+}
+
+} // namespace lz
@@ -17,6 +17,7 @@
 
 #include <cstdio>
 #include <cstdint>
+#include <array>
 #include <utility>
 #include <switch.h>
 #include <math.h>
@@ -25,10 +26,13 @@
 
 #include "fs.hpp"
 #include "gui.hpp"
+#include "backup.hpp"
 #include "lang.hpp"
 #include "save.hpp"
 #include "theme.hpp"
-#include "parser.hpp"
+#include "island.hpp"
+#include "frame_stats.hpp"
+#include "startup_trace.hpp"
 
 using namespace lang::literals;
 
@@ -36,7 +40,18 @@ constexpr static auto acnh_programid = 0x01006f8002326000ul;
 constexpr static auto save_main_path = "/main.dat";
 constexpr static auto save_hdr_path  = "/mainHeader.dat";
 
+// Holds the dumps below, the font cache and the backups
+constexpr static auto app_dir            = "/switch/Turnips";
+constexpr static auto frame_stats_path   = "sdmc:/switch/Turnips/frame_stats.txt";
+constexpr static auto startup_trace_path = "sdmc:/switch/Turnips/startup_trace.json";
+
+#ifdef FS_STATS
+constexpr static auto stats_startup_path = "sdmc:/switch/Turnips/io_stats_startup.txt";
+constexpr static auto stats_path         = "sdmc:/switch/Turnips/io_stats.txt";
+#endif
+
 extern "C" void userAppInit() {
+    tr::begin("userAppInit");
     setsysInitialize();
     plInitialize(PlServiceType_User);
     romfsInit();
@@ -44,8 +59,11 @@ extern "C" void userAppInit() {
     socketInitializeDefault();
     nxlinkStdio();
 #endif
+    tr::begin("nj_initialize");
     if (auto rc = nj::initialize(); R_FAILED(rc))
         printf("Failed to initialize library: %#x\n", rc);
+    tr::end();
+    tr::end();
 }
 
 extern "C" void userAppExit() {
@@ -58,46 +76,89 @@ extern "C" void userAppExit() {
 #endif
 }
 
-int main(int argc, char **argv) {
-    tp::TurnipParser turnip_parser; tp::VisitorParser visitor_parser; tp::DateParser date_parser; tp::WeatherSeedParser seed_parser;
-    {
-        printf("Opening save...\n");
-        FsFileSystem handle;
-        auto rc = fsOpen_DeviceSaveData(&handle, acnh_programid);
-        auto fs = fs::Filesystem(handle);
-        if (R_FAILED(rc)) {
-            printf("Failed to open save: %#x\n", rc);
-            return 1;
-        }
-        fs::File header, main;
-        if (rc = fs.open_file(header, save_hdr_path) | fs.open_file(main, save_main_path); R_FAILED(rc)) {
-            printf("Failed to open save files: %#x\n", rc);
-            return 1;
-        }
-
-        printf("Deriving keys...\n");
-        auto [key, ctr] = sv::get_keys(header);
-        printf("Decrypting save...\n");
-        auto decrypted  = sv::decrypt(main, 0xc00000, key, ctr);
-
-        printf("Parsing save...\n");
-        auto version_parser = tp::VersionParser(header);
-        turnip_parser  = tp::TurnipParser     (static_cast<tp::Version>(version_parser), decrypted);
-        visitor_parser = tp::VisitorParser    (static_cast<tp::Version>(version_parser), decrypted);
-        date_parser    = tp::DateParser       (static_cast<tp::Version>(version_parser), decrypted);
-        seed_parser    = tp::WeatherSeedParser(static_cast<tp::Version>(version_parser), decrypted);
+// Also used to reload the save after a backup is restored over it
+static Result load_island(fs::Filesystem &save_fs, tp::IslandSnapshot &island) {
+    fs::File header, main;
+    tr::begin("read_header");
+    if (auto rc = save_fs.open_file(header, save_hdr_path) | save_fs.open_file(main, save_main_path); R_FAILED(rc)) {
+        printf("Failed to open save files: %#x\n", rc);
+        return rc;
     }
 
-    auto save_date = date_parser.date;
-    auto save_ts   = date_parser.to_posix();
+    // The version info and the encryption data are read separately, fetch both at once
+    header.enable_cache();
+    header.read_ranges({{ 0, sizeof(tp::VersionInfo) }, { sv::crypt_data_offset, sv::crypt_data_size }});
+    tr::end();
+
+    printf("Deriving keys...\n");
+    tr::begin("get_keys");
+    auto [key, ctr] = sv::get_keys(header);
+    tr::end();
+    printf("Decrypting save...\n");
+    tr::begin("decrypt");
+    auto decrypted  = sv::decrypt(main, 0xc00000, key, ctr);
+    tr::end();
+
+    tr::begin("parse");
+    auto version_parser = tp::VersionParser(header);
+    island = tp::IslandSnapshot(static_cast<tp::Version>(version_parser), sv::SaveView(decrypted));
+    tr::end();
+    return 0;
+}
 
+int main(int argc, char **argv) {
+    // Load the language tables while the save is being decrypted
+    tr::begin("lang_prefetch");
+    lang::prefetch();
+    tr::end();
+
+    printf("Opening save...\n");
+    tr::begin("open_save");
+    FsFileSystem save_handle = {};
+    if (auto rc = fsOpen_DeviceSaveData(&save_handle, acnh_programid); R_FAILED(rc)) {
+        printf("Failed to open save: %#x\n", rc);
+        return 1;
+    }
+    // Kept open for the backup tab
+    auto save_fs = fs::Filesystem(save_handle);
+    tr::end();
+
+    tp::IslandSnapshot island;
+    if (R_FAILED(load_island(save_fs, island)))
+        return 1;
+
+    tr::begin("backup_store");
+    auto sd_fs = fs::Filesystem();
+    if (auto rc = sd_fs.open_sdmc(); R_FAILED(rc))
+        printf("Failed to open sd card: %#x\n", rc);
+    if (auto rc = sd_fs.create_directories(app_dir); R_FAILED(rc))
+        printf("Failed to create %s: %#x\n", app_dir, rc);
+    auto backups = bk::BackupStore(sd_fs);
+    if (auto rc = backups.initialize(); R_FAILED(rc))
+        printf("Failed to initialize backup store: %#x\n", rc);
+    tr::end();
+
+    auto has_date  = island.date().located;
+    auto save_date = island.date().date;
+    auto save_ts   = island.date().to_posix();
+
+    tr::begin("lang_init");
     if (auto rc = lang::initialize_to_system_language(); R_FAILED(rc))
         printf("Failed to init language: %#x, will fall back to key names\n", rc);
+    tr::end();
 
     printf("Starting gui\n");
+    tr::begin("gui_init");
     if (!gui::init())
         printf("Failed to init\n");
+    tr::end();
+
+#ifdef FS_STATS
+    if (!fs::stats::dump(stats_startup_path))
+        printf("Failed to write %s\n", stats_startup_path);
+#endif
 
+    tr::begin("theme");
     auto color_theme = ColorSetId_Dark;
     auto rc = setsysGetColorSetId(&color_theme);
     if (R_FAILED(rc))
@@ -106,7 +167,9 @@ int main(int argc, char **argv) {
         th::apply_theme(th::Theme::Light);
     else
         th::apply_theme(th::Theme::Dark);
+    tr::end();
 
+    tr::begin("first_frame");
     while (gui::loop()) {
         u64 ts = 0;
         auto rc = timeGetCurrentTime(TimeType_UserSystemClock, &ts);
@@ -119,37 +182,68 @@ int main(int argc, char **argv) {
         if (R_FAILED(rc))
             printf("Failed to convert timestamp\n");
 
-        bool is_outdated = (floor(ts / (24 * 60 * 60)) > floor(save_ts / (24 * 60 * 60)) + cal_info.wday)
+        bool is_outdated = has_date && (floor(ts / (24 * 60 * 60)) > floor(save_ts / (24 * 60 * 60)) + cal_info.wday)
             && ((cal_info.wday != 0) || (cal_time.hour >= 5));
 
         auto &[width, height] = im::GetIO().DisplaySize;
 
         im::SetNextWindowFocus();
-        im::Begin(std::string("app_name"_lang + ", " + "version"_lang + " " + VERSION + "-" + COMMIT + "###main").c_str(), nullptr,
+        std::array<char, 0x100> title;
+        std::snprintf(title.data(), title.size(), "%s, %s %s-%s###main", "app_name"_lang, "version"_lang, VERSION, COMMIT);
+        im::Begin(title.data(), nullptr,
             ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoMove);
         im::SetWindowPos({0.23f * width, 0.16f * height});
         im::SetWindowSize({0.55f * width, 0.73f * height});
 
-        im::Text("last_save_time"_lang.c_str(),
-            save_date.day, save_date.month, save_date.year, save_date.hour, save_date.minute, save_date.second);
+        if (has_date)
+            im::Text("last_save_time"_lang,
+                save_date.day, save_date.month, save_date.year, save_date.hour, save_date.minute, save_date.second);
+        else
+            gui::do_with_color(th::text_min_col, [] { im::TextUnformatted("save_unknown_version"_lang); });
         if (is_outdated)
-            im::SameLine(), gui::do_with_color(th::text_min_col, [] { im::TextUnformatted("save_outdated"_lang.c_str()); });
+            im::SameLine(), gui::do_with_color(th::text_min_col, [] { im::TextUnformatted("save_outdated"_lang); });
 
-        im::BeginTabBar("##tab_bar", ImGuiTabBarFlags_NoTooltip);
+        {
+            auto timer = pf::Timer(pf::Phase::Tabs);
 
-        gui::draw_turnip_tab(turnip_parser, cal_time, cal_info);
-        gui::draw_visitor_tab(visitor_parser, cal_time, cal_info);
-        gui::draw_weather_tab(seed_parser);
-        gui::draw_language_tab();
+            im::BeginTabBar("##tab_bar", ImGuiTabBarFlags_NoTooltip);
 
-        im::EndTabBar();
+            gui::draw_turnip_tab(island, cal_time, cal_info);
+            gui::draw_visitor_tab(island, cal_time, cal_info);
+            gui::draw_weather_tab(island);
+            // The restored save replaces the one that was loaded
+            if (gui::draw_backup_tab(backups, save_fs, cal_time) && R_SUCCEEDED(load_island(save_fs, island))) {
+                has_date  = island.date().located;
+                save_date = island.date().date;
+                save_ts   = island.date().to_posix();
+            }
+            gui::draw_language_tab();
+
+            im::EndTabBar();
+        }
 
         im::End();
 
         gui::render();
+
+        // The startup timeline ends with the first presented frame
+        if (!tr::is_finished()) {
+            tr::finish();
+            tr::print_summary();
+            if (!tr::dump(startup_trace_path))
+                printf("Failed to write %s\n", startup_trace_path);
+        }
     }
 
     gui::exit();
 
+    if (!pf::dump(frame_stats_path))
+        printf("Failed to write %s\n", frame_stats_path);
+
+#ifdef FS_STATS
+    if (!fs::stats::dump(stats_path))
+        printf("Failed to write %s\n", stats_path);
+#endif
+
     return 0;
 }
@@ -0,0 +1,97 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#else
+#   include <thread>
+#endif
+
+namespace par {
+
+#ifdef __SWITCH__
+// Cores available to applications
+constexpr unsigned num_cores = 3;
+#endif
+
+inline unsigned get_num_threads() {
+#ifdef __SWITCH__
+    return num_cores;
+#else
+    return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+// Calls fn(i) for every i in [0, count), spread over all cores, and returns once every call completed
+// The calling thread takes part in the work
+template <typename F>
+void for_each_index(std::size_t count, F &&fn, unsigned max_threads = get_num_threads()) {
+    std::atomic_size_t next = 0;
+    auto work = [&next, &fn, count] {
+        for (std::size_t i; (i = next++) < count;)
+            fn(i);
+    };
+
+    auto num_workers = static_cast<unsigned>(std::min<std::size_t>(max_threads, count));
+    if (num_workers <= 1)
+        return work();
+
+#ifdef __SWITCH__
+    // std::thread creates threads on the default core, which would serialize everything on it
+    auto entry = [](void *arg) {
+        (*static_cast<decltype(work) *>(arg))();
+    };
+
+    std::vector<Thread> threads;
+    threads.reserve(num_workers - 1);
+    for (unsigned core = 0, cur = svcGetCurrentProcessorNumber(); (core < num_cores) && (threads.size() < num_workers - 1); ++core) {
+        if (core == cur)
+            continue;
+        auto &thread = threads.emplace_back();
+        if (R_FAILED(threadCreate(&thread, entry, &work, nullptr, 0x10000, 0x2c, core))) {
+            threads.pop_back();
+        } else if (R_FAILED(threadStart(&thread))) {
+            threadClose(&thread);
+            threads.pop_back();
+        }
+    }
+
+    work();
+
+    for (auto &thread: threads)
+        threadWaitForExit(&thread), threadClose(&thread);
+#else
+    std::vector<std::thread> threads;
+    threads.reserve(num_workers - 1);
+    for (unsigned i = 0; i < num_workers - 1; ++i)
+        threads.emplace_back(work);
+
+    work();
+
+    for (auto &thread: threads)
+        thread.join();
+#endif
+}
+
+} // namespace par
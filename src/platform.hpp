@@ -0,0 +1,59 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// Minimal libnx surface for the parts of the code that also build on a host (save decryption/parsing)
+
+#include <cstdint>
+
+#ifdef __SWITCH__
+#   include <switch.h>
+#else
+#   include <chrono>
+
+using u8  = std::uint8_t;
+using u16 = std::uint16_t;
+using u32 = std::uint32_t;
+using u64 = std::uint64_t;
+using s8  = std::int8_t;
+using s16 = std::int16_t;
+using s32 = std::int32_t;
+using s64 = std::int64_t;
+
+// On the host, results are errno values
+using Result = u32;
+
+#   define R_SUCCEEDED(res) ((res) == 0)
+#   define R_FAILED(res)    ((res) != 0)
+#endif
+
+// Root of the resources packed into the romfs, host builds are run from the repository root
+#ifdef __SWITCH__
+#   define ROMFS_ROOT "romfs:/"
+#else
+#   define ROMFS_ROOT "res/"
+#endif
+
+// Monotonic time, for the profiling code
+inline std::uint64_t now_ns() {
+#ifdef __SWITCH__
+    return armTicksToNs(armGetSystemTick());
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -18,58 +18,66 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <array>
 #include <vector>
 #include <utility>
 
-#include <switch.h>
-
 #include "fs.hpp"
-#include "sead.hpp"
+#include "crypto.hpp"
+#include "platform.hpp"
 
 namespace sv {
 
-// From NHSE
-static std::array<std::uint8_t, 0x10> get_param(const std::vector<std::uint32_t> &crypt_data, std::size_t idx) {
-    auto sead = sead::Random(crypt_data[crypt_data[idx] & 0x7f]);
-    auto roll_count = (crypt_data[crypt_data[idx + 1] & 0x7f] & 0xf) + 1;
-
-    for (std::uint32_t i = 0; i < roll_count; ++i)
-        sead.get_u64();
-
-    std::array<std::uint8_t, 0x10> res;
-    for (std::size_t i = 0; i < res.size(); i++)
-        res[i] = sead.get_u32() >> 24;
-    return res;
+inline std::pair<Key, Key> get_keys(const std::vector<std::uint32_t> &crypt_data) {
+    auto key = get_param(crypt_data, 0);
+    auto ctr = get_param(crypt_data, 2);
+    return {std::move(key), std::move(ctr)};
 }
 
-static std::pair<std::array<std::uint8_t, 0x10>, std::array<std::uint8_t, 0x10>> get_keys(fs::File &header) {
-    constexpr std::size_t crypt_data_size = 0x200;
-
-    std::vector<std::uint32_t> crypt_data(0x200, 0);
-    if (auto read = header.read(crypt_data.data(), crypt_data.size(), 0x100); read != crypt_data_size)
+inline std::pair<Key, Key> get_keys(fs::File &header) {
+    std::vector<std::uint32_t> crypt_data(crypt_data_size, 0);
+    if (auto read = header.read(crypt_data.data(), crypt_data_size, crypt_data_offset); read != crypt_data_size)
         printf("Failed to read header encryption data (got %#lx bytes, expected %#lx)\n", read, crypt_data_size);
+    return get_keys(crypt_data);
+}
 
-    auto key = get_param(crypt_data, 0);
-    auto ctr = get_param(crypt_data, 2);
-    return {std::move(key), std::move(ctr)};
+// From an in-memory copy of the header
+inline std::pair<Key, Key> get_keys(const std::uint8_t *header, std::size_t size) {
+    std::vector<std::uint32_t> crypt_data(crypt_data_size, 0);
+    if (size >= crypt_data_offset + crypt_data_size)
+        std::memcpy(crypt_data.data(), header + crypt_data_offset, crypt_data_size);
+    else
+        printf("Header too small for encryption data (%#lx bytes)\n", size);
+    return get_keys(crypt_data);
 }
 
-static std::vector<std::uint8_t> decrypt(fs::File &main, std::size_t size,
-        const std::array<std::uint8_t, 0x10> &key, const std::array<std::uint8_t, 0x10> ctr) {
-    Aes128CtrContext ctx;
-    aes128CtrContextCreate(&ctx, key.data(), ctr.data());
+inline std::vector<std::uint8_t> decrypt(fs::File &main, std::size_t size, const Key &key, const Key &ctr) {
+    auto aes = Aes128Ctr(key, ctr);
+
+    // Decrypt straight from the page cache when the backend supports it
+    if (auto mapped = main.map(true); !mapped.empty()) {
+        std::vector<std::uint8_t> res(size, 0);
+        aes.crypt(res.data(), mapped.data(), std::min(size, mapped.size()));
+        return res;
+    }
 
-    std::size_t offset = 0, read = 0, buf_size = std::clamp(size, 0x1000ul, 0x80000ul);
-    std::vector<std::uint8_t> buf(buf_size, 0);
+    std::size_t offset = 0, buf_size = std::clamp(size, 0x1000ul, 0x80000ul);
+    std::array<std::vector<std::uint8_t>, 2> bufs = { std::vector<std::uint8_t>(buf_size), std::vector<std::uint8_t>(buf_size) };
     std::vector<std::uint8_t> res(size, 0);
 
-    while (offset < size) {
-        read = main.read(buf.data(), buf.size(), offset);
-        aes128CtrCrypt(&ctx, &res[offset], buf.data(), read);
+    // Double-buffered: the next chunk is read in the background while the current one is decrypted
+    main.prefetch(0, size);
+    auto pending = main.read_async(bufs[0].data(), std::min(size, buf_size), 0);
+    for (std::size_t i = 0; offset < size; i ^= 1) {
+        auto read = pending.wait();
+        bool is_last = (read != std::min(size - offset, buf_size)) || (offset + read >= size);
+        if (!is_last)
+            pending = main.read_async(bufs[i ^ 1].data(), std::min(size - offset - read, buf_size), offset + read);
+        aes.crypt(&res[offset], bufs[i].data(), read);
         offset += read;
-        if (read != buf.size())
+        if (is_last)
             break;
     }
 
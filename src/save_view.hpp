@@ -0,0 +1,103 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+namespace sv {
+
+// Non-owning view over (part of) a decrypted save
+// Offsets are absolute save offsets: a view over a range starting at `base` (eg. a cached chunk)
+// is accessed with the same offsets as a view over the whole buffer
+// Accesses are bounds-checked in debug builds only
+class SaveView {
+    private:
+        std::span<const std::uint8_t> bytes = {};
+        std::size_t                   base  = 0;
+
+    public:
+        constexpr inline SaveView() = default;
+        constexpr inline SaveView(std::span<const std::uint8_t> bytes, std::size_t base = 0): bytes(bytes), base(base) { }
+
+        constexpr inline std::size_t begin_offset() const {
+            return this->base;
+        }
+
+        constexpr inline std::size_t end_offset() const {
+            return this->base + this->bytes.size();
+        }
+
+        constexpr inline std::size_t size() const {
+            return this->bytes.size();
+        }
+
+        constexpr inline const std::uint8_t *data() const {
+            return this->bytes.data();
+        }
+
+        constexpr inline bool contains(std::size_t offset, std::size_t size) const {
+            return (offset >= this->base) && (size <= this->bytes.size()) && (offset - this->base <= this->bytes.size() - size);
+        }
+
+        inline SaveView subview(std::size_t offset, std::size_t size) const {
+            this->check(offset, size);
+            return SaveView(this->bytes.subspan(offset - this->base, size), offset);
+        }
+
+        // Reference into the underlying memory, the offset must be suitably aligned
+        template <typename T>
+        inline const T &get(std::size_t offset) const {
+            static_assert(std::is_trivially_copyable_v<T>);
+            this->check(offset, sizeof(T));
+#ifdef DEBUG
+            if (reinterpret_cast<std::uintptr_t>(&this->bytes[offset - this->base]) % alignof(T)) {
+                printf("Misaligned save access at %#lx\n", offset);
+                std::abort();
+            }
+#endif
+            return *reinterpret_cast<const T *>(&this->bytes[offset - this->base]);
+        }
+
+        // Copy out of the underlying memory, no alignment requirement
+        template <typename T>
+        inline T load(std::size_t offset) const {
+            static_assert(std::is_trivially_copyable_v<T>);
+            this->check(offset, sizeof(T));
+            T tmp;
+            std::memcpy(&tmp, &this->bytes[offset - this->base], sizeof(T));
+            return tmp;
+        }
+
+    private:
+        inline void check([[maybe_unused]] std::size_t offset, [[maybe_unused]] std::size_t size) const {
+#ifdef DEBUG
+            if (!this->contains(offset, size)) {
+                printf("Out of bounds save access at %#lx (size %#lx), view is [%#lx, %#lx)\n",
+                    offset, size, this->begin_offset(), this->end_offset());
+                std::abort();
+            }
+#endif
+        }
+};
+
+} // namespace sv
@@ -0,0 +1,120 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+
+#include "platform.hpp"
+#include "startup_trace.hpp"
+
+namespace tr {
+
+namespace {
+
+// Startup has a few dozen steps at most, later spans are dropped
+constexpr std::size_t max_spans = 64;
+constexpr std::size_t max_depth = 8;
+
+struct Span {
+    const char   *name;
+    std::uint64_t start_ns, end_ns;
+    std::uint32_t depth;
+};
+
+std::array<Span, max_spans>        spans;
+std::array<std::size_t, max_depth> open;
+std::size_t                        num_spans = 0, depth = 0, num_dropped = 0;
+bool                               finished  = false;
+
+std::uint64_t get_origin() {
+    return num_spans ? spans[0].start_ns : 0;
+}
+
+} // namespace
+
+void begin(const char *name) {
+    if (finished)
+        return;
+
+    // Spans past the limits are dropped, but still take a level so that end() pairs up
+    auto index = SIZE_MAX;
+    if ((num_spans < max_spans) && (depth < max_depth))
+        index = num_spans++, spans[index] = { name, now_ns(), 0, static_cast<std::uint32_t>(depth) };
+    else
+        ++num_dropped;
+
+    if (depth < max_depth)
+        open[depth] = index;
+    ++depth;
+}
+
+void end() {
+    if (finished || !depth)
+        return;
+
+    if ((--depth < max_depth) && (open[depth] != SIZE_MAX))
+        spans[open[depth]].end_ns = now_ns();
+}
+
+void finish() {
+    while (depth)
+        end();
+    finished = true;
+}
+
+bool is_finished() {
+    return finished;
+}
+
+void print_summary() {
+    auto origin = get_origin();
+    std::uint64_t total_ns = 0;
+    for (std::size_t i = 0; i < num_spans; ++i)
+        total_ns = std::max(total_ns, spans[i].end_ns - origin);
+
+    std::printf("Startup took %.1fms\n", total_ns / 1e6);
+    for (std::size_t i = 0; i < num_spans; ++i) {
+        auto &s = spans[i];
+        std::printf("  %*s%-*s %8.1fms at %8.1fms\n", 2 * s.depth, "", 24 - 2 * s.depth, s.name,
+            (s.end_ns - s.start_ns) / 1e6, (s.start_ns - origin) / 1e6);
+    }
+    if (num_dropped)
+        std::printf("  %zu spans dropped\n", num_dropped);
+}
+
+bool dump(const std::string &path) {
+    auto *fp = std::fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+
+    // Complete events ("ph": "X"), in microseconds
+    auto origin = get_origin();
+    std::fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (std::size_t i = 0; i < num_spans; ++i) {
+        auto &s = spans[i];
+        std::fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            i ? "," : "", s.name, (s.start_ns - origin) / 1e3, (s.end_ns - s.start_ns) / 1e3);
+    }
+    std::fprintf(fp, "\n]}\n");
+
+    std::fclose(fp);
+    return true;
+}
+
+} // namespace tr
@@ -0,0 +1,51 @@
+// Copyright (C) 2020 averne
+//
+// This file is part of Turnips.
+//
+// Turnips is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Turnips is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Turnips.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Timeline of the startup, from userAppInit to the first presented frame: each step records a span with monotonic
+// timestamps, written as a Chrome trace (chrome://tracing, ui.perfetto.dev) once the first frame is on screen
+// Spans nest, and are recorded from the main thread only. Past finish(), they are no-ops
+namespace tr {
+
+void begin(const char *name);
+void end();
+
+// Closes the spans still open, and stops the recording
+void finish();
+bool is_finished();
+
+// Every span with its start time and duration, indented by depth
+void print_summary();
+bool dump(const std::string &path);
+
+// Traces the enclosing scope, `name` must outlive the trace
+class Span {
+    public:
+        inline Span(const char *name) {
+            begin(name);
+        }
+
+        inline ~Span() {
+            end();
+        }
+};
+
+} // namespace tr